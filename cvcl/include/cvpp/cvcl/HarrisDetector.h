@@ -53,7 +53,7 @@ void HarrisDetector(Image<T>& in, unsigned int patchSize, float threshold, std::
 	std::mutex mtx;
 
 	cvpp::Image<float> cpuImg = determinant.toImage(q);
-	cvpp::NonLinearConv2D<-1>(cvpp::ClampView(cpuImg), patchSize,
+	cvpp::PatchReduce(cvpp::ClampView(cpuImg), patchSize,
 	[](int x, int y, auto v, auto& result) {
 		auto vabs = std::abs(v[0]);
 		if(vabs >= result[0])
@@ -86,7 +86,7 @@ void HessianDetector(Image<T>& in, unsigned int patchSize, float threshold, std:
 	
 	std::mutex mtx;
 	cvpp::Image<float> cpuImg = determinant;
-	cvpp::NonLinearConv2D<-1>(cvpp::ClampView(cpuImg), patchSize,
+	cvpp::PatchReduce(cvpp::ClampView(cpuImg), patchSize,
 	[](int x, int y, auto v, auto& result) {
 		auto vabs = std::abs(v[0]);
 		if(vabs >= result[0])
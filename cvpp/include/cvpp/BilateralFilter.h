@@ -0,0 +1,207 @@
+#ifndef __BILATERAL_FILTER_H__
+#define __BILATERAL_FILTER_H__
+
+#include "Image.h"
+#include "Sampler.h"
+#include "Convolution.h"
+
+namespace cvpp
+{
+
+namespace detail
+{
+// Grid of the bilateral filter: cells of sigmaSpace x sigmaSpace pixels and sigmaRange
+// intensities, each with the sum of the colors splatted into it and their count.
+// A border of Pad cells keeps the blur inside the grid.
+class BilateralGrid
+{
+public:
+	static constexpr int Pad = 2;
+
+	BilateralGrid(int w, int h, int comps, float sigmaSpace, float sigmaRange, float minValue, float maxValue):
+		m_comps(comps),
+		m_cells(comps + 1),
+		m_width((w - 1)/sigmaSpace + 1 + 2*Pad),
+		m_height((h - 1)/sigmaSpace + 1 + 2*Pad),
+		m_depth((maxValue - minValue)/sigmaRange + 1 + 2*Pad),
+		m_scaleSpace(1.0f/sigmaSpace),
+		m_scaleRange(1.0f/sigmaRange),
+		m_minValue(minValue)
+	{
+		m_data.resize(size_t(m_width)*m_height*m_depth*m_cells);
+	}
+
+	int getWidth() const { return m_width; }
+	int getHeight() const { return m_height; }
+	int getDepth() const { return m_depth; }
+
+	float toX(float x) const { return x*m_scaleSpace + Pad; }
+	float toZ(float v) const { return (v - m_minValue)*m_scaleRange + Pad; }
+
+	float* cell(int gx, int gy, int gz) { return &m_data[((size_t(gy)*m_width + gx)*m_depth + gz)*m_cells]; }
+	const float* cell(int gx, int gy, int gz) const { return &m_data[((size_t(gy)*m_width + gx)*m_depth + gz)*m_cells]; }
+
+	// Adds a pixel to its nearest cell, grid coordinates are positive so truncation rounds
+	void splat(float x, float y, float value, const float* color)
+	{
+		float* c = cell(int(toX(x) + 0.5f), int(toX(y) + 0.5f), int(toZ(value) + 0.5f));
+		for(int i = 0; i < m_comps; i++)
+			c[i] += color[i];
+
+		c[m_comps] += 1.0f;
+	}
+
+	// Gaussian of one cell along every axis, [1 4 6 4 1]/16 has a variance of 1
+	void blur()
+	{
+		const size_t depthStride = m_cells;
+		const size_t widthStride = size_t(m_depth)*m_cells;
+		const size_t heightStride = size_t(m_width)*widthStride;
+
+		// Along the depth, lines are the (gx, gy) columns
+		#pragma omp parallel for
+		for(int i = 0; i < m_width*m_height; i++)
+			blurLine(&m_data[i*widthStride], m_depth, depthStride);
+
+		#pragma omp parallel for
+		for(int gy = 0; gy < m_height; gy++)
+			for(int gz = 0; gz < m_depth; gz++)
+				blurLine(&m_data[gy*heightStride + gz*depthStride], m_width, widthStride);
+
+		#pragma omp parallel for
+		for(int gx = 0; gx < m_width; gx++)
+			for(int gz = 0; gz < m_depth; gz++)
+				blurLine(&m_data[gx*widthStride + gz*depthStride], m_height, heightStride);
+	}
+
+	// Trilinear interpolation of the blurred grid, normalized by the count
+	void slice(float x, float y, float value, float* color) const
+	{
+		const float fx = toX(x), fy = toX(y), fz = toZ(value);
+		const int x0 = fx, y0 = fy, z0 = fz;
+		const float ax = fx - x0, ay = fy - y0, az = fz - z0;
+
+		float sum[5] = {};
+		for(int corner = 0; corner < 8; corner++)
+		{
+			const int dx = corner & 1, dy = (corner >> 1) & 1, dz = corner >> 2;
+			const float weight = (dx ? ax : 1.0f - ax)*(dy ? ay : 1.0f - ay)*(dz ? az : 1.0f - az);
+			const float* c = cell(x0 + dx, y0 + dy, z0 + dz);
+			for(int i = 0; i < m_cells; i++)
+				sum[i] += weight*c[i];
+		}
+
+		const float norm = sum[m_comps] > 0.0f ? 1.0f/sum[m_comps] : 0.0f;
+		for(int i = 0; i < m_comps; i++)
+			color[i] = sum[i]*norm;
+	}
+
+private:
+	// Blurs count cells which are stride apart, all values of a cell at once
+	void blurLine(float* data, int count, size_t stride) const
+	{
+		constexpr float Weights[5] = {1.0f/16.0f, 4.0f/16.0f, 6.0f/16.0f, 4.0f/16.0f, 1.0f/16.0f};
+
+		// The last two inputs are all that is overwritten before it is read
+		float history[2][5] = {};
+		for(int i = 0; i < count; i++)
+		{
+			float result[5] = {};
+			for(int k = -2; k <= 2; k++)
+			{
+				const int j = i + k;
+				if(j < 0 || j >= count)
+					continue;
+
+				const float* c = (k < 0 ? history[j % 2] : data + j*stride);
+				for(int v = 0; v < m_cells; v++)
+					result[v] += Weights[k + 2]*c[v];
+			}
+
+			float* c = data + i*stride;
+			std::copy_n(c, m_cells, history[i % 2]);
+			std::copy_n(result, m_cells, c);
+		}
+	}
+
+	int m_comps = 0;
+	int m_cells = 0;
+	int m_width = 0;
+	int m_height = 0;
+	int m_depth = 0;
+	float m_scaleSpace = 1.0f;
+	float m_scaleRange = 1.0f;
+	float m_minValue = 0.0f;
+	std::vector<float> m_data;
+};
+}
+
+// Edge preserving smoothing with a Gaussian of sigmaSpace pixels which only averages
+// values within about sigmaRange of the center, in ColorToFloat units of the mean of
+// all channels. Uses the bilateral grid of Chen, Paris & Durand, "Real-time Edge-Aware
+// Image Processing with the Bilateral Grid", 2007: pixels are splatted into a grid
+// downsampled by the sigmas, the grid is blurred and the result sliced out again, so
+// the cost barely depends on sigmaSpace. Splatting runs in parallel over the rows of
+// the grid, which no other row touches, blurring over the lines of every axis and
+// slicing over the rows of the image.
+template<typename T>
+CPUImage<T> BilateralFilter(const SamplerView<T>& sampler, float sigmaSpace, float sigmaRange)
+{
+	assert(sigmaSpace > 0.0f && sigmaRange > 0.0f && "The sigmas need to be positive!");
+
+	const CPUImage<T>& in = *sampler.getImage();
+	CPUImage<T> out(in.getWidth(), in.getHeight(), in.getComponents());
+	const int w = in.getWidth();
+	const int h = in.getHeight();
+	const int comps = in.getComponents();
+	const size_t rowSize = size_t(w)*comps;
+	const auto& kernels = Dispatch::getKernels();
+
+	std::vector<float> colors(rowSize*h), guide(size_t(w)*h);
+	const float weights[] = {1.0f, 1.0f, 1.0f, 1.0f};
+
+	#pragma omp parallel for
+	for(int y = 0; y < h; y++)
+	{
+		sampler.sampleRow(y, 0, w, &colors[y*rowSize]);
+		kernels.grayscale(&colors[y*rowSize], &guide[size_t(y)*w], w, comps, weights);
+	}
+
+	float minValue = 0.0f, maxValue = 0.0f;
+	kernels.minMax(guide.data(), guide.size(), minValue, maxValue);
+
+	detail::BilateralGrid grid(w, h, comps, sigmaSpace, sigmaRange, minValue, maxValue);
+
+	// Image rows splatted into every row of the grid
+	std::vector<int> firstRow(grid.getHeight() + 1, h);
+	for(int y = h - 1; y >= 0; y--)
+		firstRow[int(grid.toX(y) + 0.5f)] = y;
+	for(int gy = grid.getHeight() - 1; gy >= 0; gy--)
+		firstRow[gy] = std::min(firstRow[gy], firstRow[gy + 1]);
+
+	#pragma omp parallel for
+	for(int gy = 0; gy < grid.getHeight(); gy++)
+	{
+		for(int y = firstRow[gy]; y < firstRow[gy + 1]; y++)
+			for(int x = 0; x < w; x++)
+				grid.splat(x, y, guide[size_t(y)*w + x], &colors[y*rowSize + x*comps]);
+	}
+
+	grid.blur();
+
+	#pragma omp parallel for
+	for(int y = 0; y < h; y++)
+	{
+		std::vector<float> result(rowSize);
+		for(int x = 0; x < w; x++)
+			grid.slice(x, y, guide[size_t(y)*w + x], &result[x*comps]);
+
+		detail::FromFloat(result.data(), out.get(0, y), rowSize);
+	}
+
+	return out;
+}
+
+}
+
+#endif
@@ -0,0 +1,339 @@
+#ifndef __BLUR_H__
+#define __BLUR_H__
+
+#include "Image.h"
+#include "Sampler.h"
+#include "Convolution.h"
+
+#include <array>
+#include <cmath>
+#include <complex>
+
+namespace cvpp
+{
+
+namespace detail
+{
+// Window weights of the running sum filters: 1 for a box, radius + 1 - |k|
+// for the triangle of a stack blur.
+enum RUNNING_SUM_TYPE
+{
+	RUNNING_BOX,
+	RUNNING_STACK
+};
+
+// Running sums over count vectors of width floats, at(n) points to vector n for
+// -radius <= n < count + radius and sees the vectors entering the window in
+// increasing order. emit(n, sums) gets the window sums of vector n. Every step adds
+// the vector entering the window and removes the one leaving it; the stack blur keeps
+// the left and right half of the window apart so the triangle can be shifted the same
+// way. sums is scratch for 3*width floats.
+template<RUNNING_SUM_TYPE Type, typename At, typename Emit>
+void RunningSumPass(At&& at, size_t width, int count, int radius, float* sums, Emit&& emit)
+{
+	float* sum = sums;
+	float* sumIn = sums + width;
+	float* sumOut = sums + 2*width;
+
+	std::fill_n(sums, 3*width, 0.0f);
+	for(int k = -radius; k <= radius; k++)
+	{
+		const float* v = at(k);
+		const float weight = (Type == RUNNING_STACK ? radius + 1 - std::abs(k) : 1);
+		for(size_t j = 0; j < width; j++)
+			sum[j] += weight*v[j];
+
+		if constexpr(Type == RUNNING_STACK)
+		{
+			float* half = (k <= 0 ? sumOut : sumIn);
+			for(size_t j = 0; j < width; j++)
+				half[j] += v[j];
+		}
+	}
+
+	emit(0, sum);
+
+	for(int n = 1; n < count; n++)
+	{
+		const float* enter = at(n + radius);
+		const float* leave = at(n - 1 - radius);
+		const float* center = at(n);
+
+		if constexpr(Type == RUNNING_STACK)
+		{
+			// Loops of few streams each, which the compiler vectorizes
+			for(size_t j = 0; j < width; j++)
+				sum[j] -= sumOut[j];
+			for(size_t j = 0; j < width; j++)
+				sumOut[j] += center[j] - leave[j];
+			for(size_t j = 0; j < width; j++)
+				sumIn[j] += enter[j];
+			for(size_t j = 0; j < width; j++)
+				sum[j] += sumIn[j];
+			for(size_t j = 0; j < width; j++)
+				sumIn[j] -= center[j];
+		}
+		else
+		{
+			for(size_t j = 0; j < width; j++)
+				sum[j] += enter[j] - leave[j];
+		}
+
+		emit(n, sum);
+	}
+}
+
+// Both passes of a running sum filter at a cost independent of the radius. The image is
+// cut into strips of columns and bands of rows which run in parallel, each streaming down
+// its band once: the vertical sums advance by whole rows of the strip padded by radius
+// pixels, which are kept in a ring of the window plus the row that just left it. Every
+// band primes its own ring, so bands are at least 8 windows high to keep the rows fetched
+// twice below an eighth of the work. Groups of vertically summed rows are
+// interleaved so every horizontal step is a vector over all rows of a group.
+// fetch(y, x0, x1, dst) writes pixels x0 ... x1 - 1 of row y, store(y, x0, x1, result)
+// receives the same pixels of the filtered row, so per pixel work before and after the
+// sums needs no images of its own. Both are called from several threads.
+template<RUNNING_SUM_TYPE Type, typename Fetch, typename Store>
+void RunningSumRows(int w, int h, int comps, unsigned int radius, float norm, Fetch&& fetch, Store&& store)
+{
+	constexpr int Lanes = 16;
+	constexpr int StripPixels = 512;
+	constexpr int MinBandRows = 128;
+
+	const int r = radius;
+	const int strips = (w + StripPixels - 1)/StripPixels;
+	const int bandRows = (std::max(MinBandRows, 8*(2*r + 1)) + Lanes - 1)/Lanes*Lanes;
+	const int bands = (h + bandRows - 1)/bandRows;
+	const float scale = norm*norm;
+
+	WithComponents(comps, [&](auto C) {
+		const int Comps = C;
+		const size_t LaneSize = size_t(Lanes)*Comps;
+
+		#pragma omp parallel for collapse(2) schedule(dynamic)
+		for(int b = 0; b < bands; b++)
+		{
+			for(int s = 0; s < strips; s++)
+			{
+				const int x0 = s*StripPixels;
+				const int x1 = std::min(w, x0 + StripPixels);
+				const int y0 = b*bandRows;
+				const int y1 = std::min(h, y0 + bandRows);
+				const int sw = x1 - x0;
+				const int pw = sw + 2*r;
+				const size_t paddedSize = size_t(pw)*Comps;
+
+				// Fetched rows y - r - 1 ... y + r
+				const int ringRows = 2*r + 2;
+				std::vector<float> ring(ringRows*paddedSize), columnSums(3*paddedSize);
+				std::vector<float> interleaved(pw*LaneSize), rowSums(3*LaneSize), filtered(sw*LaneSize), result(size_t(sw)*Comps);
+				int fetched = y0 - r;
+
+				auto row = [&](int n) {
+					const int y = y0 + n;
+					float* slot = &ring[mod(y, ringRows)*paddedSize];
+					if(y >= fetched)
+					{
+						fetch(y, x0 - r, x1 + r, slot);
+						fetched = y + 1;
+					}
+
+					return slot;
+				};
+
+				auto horizontal = [&](int y, int count) {
+					RunningSumPass<Type>([&](int n) { return &interleaved[(n + r)*LaneSize]; }, count*Comps, sw, r, rowSums.data(),
+						[&](int x, const float* sum) { std::copy_n(sum, count*Comps, &filtered[x*LaneSize]); });
+
+					for(int g = 0; g < count; g++)
+					{
+						for(int x = 0; x < sw; x++)
+							for(int c = 0; c < Comps; c++)
+								result[x*Comps + c] = filtered[x*LaneSize + g*Comps + c]*scale;
+
+						store(y + g, x0, x1, result.data());
+					}
+				};
+
+				RunningSumPass<Type>(row, paddedSize, y1 - y0, r, columnSums.data(), [&](int n, const float* sum) {
+					const int g = n % Lanes;
+					for(int x = 0; x < pw; x++)
+						for(int c = 0; c < Comps; c++)
+							interleaved[x*LaneSize + g*Comps + c] = sum[x*Comps + c];
+
+					if(g == Lanes - 1 || y0 + n == y1 - 1)
+						horizontal(y0 + n - g, g + 1);
+				});
+			}
+		}
+	});
+}
+
+template<RUNNING_SUM_TYPE Type, typename T>
+CPUImage<T> RunningSumFilter(const SamplerView<T>& sampler, unsigned int radius, float norm)
+{
+	const CPUImage<T>& in = *sampler.getImage();
+	CPUImage<T> out(in.getWidth(), in.getHeight(), in.getComponents());
+	const int comps = in.getComponents();
+
+	RunningSumRows<Type>(in.getWidth(), in.getHeight(), comps, radius, norm,
+		[&](int y, int x0, int x1, float* dst) { sampler.sampleRow(y, x0, x1, dst); },
+		[&](int y, int x0, int x1, const float* result) { FromFloat(result, out.get(x0, y), size_t(x1 - x0)*comps); });
+
+	return out;
+}
+
+// Third order recursive Gaussian of van Vliet, Young & Verbeek, "Recursive Gaussian
+// derivative filters", 1998: the poles fitted for sigma = 2 are scaled by d^(1/q), q
+// chosen so the variance of the cascade matches sigma^2. Returned as B, -a1, -a2, -a3
+// of y[n] = B*x[n] - a1*y[n - 1] - a2*y[n - 2] - a3*y[n - 3] for KernelTable::convolveColumns.
+inline std::array<float, 4> RecursiveGaussianCoefficients(float sigma)
+{
+	using Complex = std::complex<double>;
+	const Complex poles[3] = {{1.40098, 1.00236}, {1.40098, -1.00236}, {1.85132, 0.0}};
+
+	auto scaled = [&](int i, double q) { return std::pow(poles[i], 1.0/q); };
+	auto variance = [&](double q) {
+		Complex v = 0.0;
+		for(int i = 0; i < 3; i++)
+		{
+			const Complex d = scaled(i, q);
+			v += 2.0*d/((d - 1.0)*(d - 1.0));
+		}
+		return v.real();
+	};
+
+	// The variance grows monotonically with q
+	double lo = 0.01, hi = 1000.0;
+	for(int i = 0; i < 64; i++)
+	{
+		const double q = std::sqrt(lo*hi);
+		(variance(q) < double(sigma)*sigma ? lo : hi) = q;
+	}
+
+	const double q = std::sqrt(lo*hi);
+	const Complex d1 = scaled(0, q), d2 = scaled(1, q), d3 = scaled(2, q);
+	const double a1 = -(1.0/d1 + 1.0/d2 + 1.0/d3).real();
+	const double a2 = (1.0/(d1*d2) + 1.0/(d1*d3) + 1.0/(d2*d3)).real();
+	const double a3 = -(1.0/(d1*d2*d3)).real();
+
+	return {float(1.0 + a1 + a2 + a3), float(-a1), float(-a2), float(-a3)};
+}
+
+// One causal (or anticausal if backward) pass in place over count vectors of width
+// floats which are stride apart, each step handles a whole vector. The filter
+// starts in the steady state of the first vector.
+inline void RecursivePass(float* data, int count, size_t stride, size_t width, bool backward, const std::array<float, 4>& coeffs)
+{
+	const auto& kernels = Dispatch::getKernels();
+	auto at = [&](int n) { return data + (backward ? count - 1 - std::max(n, 0) : std::max(n, 0))*stride; };
+
+	const float* rows[4];
+	for(int n = 1; n < count; n++)
+	{
+		float* current = at(n);
+		rows[0] = current;
+		rows[1] = at(n - 1);
+		rows[2] = at(n - 2);
+		rows[3] = at(n - 3);
+		kernels.convolveColumns(rows, current, width, coeffs.data(), 4);
+	}
+}
+}
+
+// Mean over a (2*radius + 1)^2 window, same as ConvoluteSeparable with
+// BoxFilter<2*radius + 1>() but at a cost independent of the radius.
+template<typename T>
+CPUImage<T> BoxBlur(const SamplerView<T>& sampler, unsigned int radius)
+{
+	return detail::RunningSumFilter<detail::RUNNING_BOX>(sampler, radius, 1.0f/(2*radius + 1));
+}
+
+// Triangle filter of StackBlurFilter<2*radius + 1>() at a cost independent of the radius.
+// https://observablehq.com/@jobleonard/mario-klingemans-stackblur
+template<typename T>
+CPUImage<T> StackBlur(const SamplerView<T>& sampler, unsigned int radius)
+{
+	const float n = radius + 1;
+	return detail::RunningSumFilter<detail::RUNNING_STACK>(sampler, radius, 1.0f/(n*n));
+}
+
+// Gaussian blur for any sigma >= 0.5 at a cost independent of sigma, as a causal and
+// an anticausal third order recursive filter in both directions. The recursion
+// runs over vectors: horizontally on blocks of rows interleaved so that a step
+// advances all of them, vertically on strips of whole rows. Borders follow the
+// sampler for a margin of 3 sigma.
+template<typename T>
+CPUImage<T> RecursiveGaussian(const SamplerView<T>& sampler, float sigma)
+{
+	assert(sigma >= 0.5f && "The recursive Gaussian needs sigma >= 0.5!");
+
+	// Rows interleaved per horizontal step, a multiple of 64 floats keeps the kernel on full vectors
+	constexpr int Lanes = 64;
+	constexpr size_t StripWidth = 256;
+
+	const CPUImage<T>& in = *sampler.getImage();
+	CPUImage<T> out(in.getWidth(), in.getHeight(), in.getComponents());
+	const int w = in.getWidth();
+	const int h = in.getHeight();
+	const int comps = in.getComponents();
+	const size_t rowSize = size_t(w)*comps;
+
+	const int margin = std::ceil(3.0f*sigma) + 3;
+	const int paddedW = w + 2*margin;
+	const int paddedH = h + 2*margin;
+	const auto coeffs = detail::RecursiveGaussianCoefficients(sigma);
+
+	// Horizontally filtered rows -margin ... h + margin - 1
+	std::vector<float> tmp(size_t(paddedH)*rowSize);
+
+	detail::ForEachRowBlock(paddedH, [&](int y0, int y1) {
+		const size_t laneSize = size_t(Lanes)*comps;
+		std::vector<float> row(size_t(paddedW)*comps);
+		std::vector<float> interleaved(size_t(paddedW)*laneSize);
+
+		for(int y = y0; y < y1; y += Lanes)
+		{
+			const int count = std::min(Lanes, y1 - y);
+			for(int g = 0; g < count; g++)
+			{
+				sampler.sampleRow(y + g - margin, -margin, w + margin, row.data());
+				for(int x = 0; x < paddedW; x++)
+					for(int c = 0; c < comps; c++)
+						interleaved[x*laneSize + g*comps + c] = row[x*comps + c];
+			}
+
+			detail::RecursivePass(interleaved.data(), paddedW, laneSize, laneSize, false, coeffs);
+			detail::RecursivePass(interleaved.data(), paddedW, laneSize, laneSize, true, coeffs);
+
+			for(int g = 0; g < count; g++)
+			{
+				float* dst = &tmp[(y + g)*rowSize];
+				for(int x = 0; x < w; x++)
+					for(int c = 0; c < comps; c++)
+						dst[x*comps + c] = interleaved[(x + margin)*laneSize + g*comps + c];
+			}
+		}
+	});
+
+	const int strips = (rowSize + StripWidth - 1)/StripWidth;
+
+#pragma omp parallel for
+	for(int s = 0; s < strips; s++)
+	{
+		const size_t x0 = s*StripWidth;
+		const size_t width = std::min(StripWidth, rowSize - x0);
+
+		detail::RecursivePass(&tmp[x0], paddedH, rowSize, width, false, coeffs);
+		detail::RecursivePass(&tmp[x0], paddedH, rowSize, width, true, coeffs);
+
+		for(int y = 0; y < h; y++)
+			detail::FromFloat(&tmp[(y + margin)*rowSize + x0], out.get(0, y) + x0, width);
+	}
+
+	return out;
+}
+
+}
+
+#endif
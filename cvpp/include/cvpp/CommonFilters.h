@@ -2,13 +2,14 @@
 #define __COMMON_FILTERS_H__
 
 #include <eigen3/Eigen/StdVector>
+#include "FixedKernel.h"
 
 namespace cvpp
 {
 
 const Eigen::Vector3f SimpleEdgeDetector(0.5f, 0, -0.5f);
 
-Eigen::Matrix3f SobelFilterH()
+inline Eigen::Matrix3f SobelFilterH()
 {
 	Eigen::Matrix3f mtx;
 	mtx <<	-1, 0, 1,
@@ -18,12 +19,12 @@ Eigen::Matrix3f SobelFilterH()
 	return mtx;
 }
 
-Eigen::Matrix3f SobelFilterV()
+inline Eigen::Matrix3f SobelFilterV()
 {
 	return SobelFilterH().transpose();
 }
 
-Eigen::Matrix3f ScharrFilterH()
+inline Eigen::Matrix3f ScharrFilterH()
 {
 	Eigen::Matrix3f mtx;
 	mtx <<	3,  0, -3,
@@ -33,13 +34,13 @@ Eigen::Matrix3f ScharrFilterH()
 	return mtx;
 }
 
-Eigen::Matrix3f ScharrFilterV()
+inline Eigen::Matrix3f ScharrFilterV()
 {
 	return ScharrFilterH().transpose();
 }
 
 const Eigen::Vector3f LaplaceFilterX(1, -2, 1);
-auto LaplaceFilter()
+inline auto LaplaceFilter()
 {
 	Eigen::Matrix3f mtx;
 	mtx <<	1,  1, 1,
@@ -49,7 +50,7 @@ auto LaplaceFilter()
 	return mtx;
 }
 
-auto LaplaceFilterXY()
+inline auto LaplaceFilterXY()
 {
 	Eigen::Matrix3f mtx;
 	mtx <<	1,  0, 0,
@@ -59,6 +60,35 @@ auto LaplaceFilterXY()
 	return mtx;
 }
 
+// Compile time versions of the filters above
+using SobelKernelH = FixedKernel<3,
+	-1, 0, 1,
+	-2, 0, 2,
+	-1, 0, 1>;
+using SobelKernelV = TransposedKernel<SobelKernelH>;
+
+using ScharrKernelH = FixedKernel<3,
+	3,  0, -3,
+	10, 0, -10,
+	3,  0, -3>;
+using ScharrKernelV = TransposedKernel<ScharrKernelH>;
+
+using LaplaceKernel = FixedKernel<3,
+	1,  1, 1,
+	1, -8, 1,
+	1,  1, 1>;
+
+using LaplaceKernelX = FixedKernel<3,
+	0,  0, 0,
+	1, -2, 1,
+	0,  0, 0>;
+using LaplaceKernelY = TransposedKernel<LaplaceKernelX>;
+
+using LaplaceKernelXY = FixedKernel<3,
+	1,  0, 0,
+	0, -2, 0,
+	0,  0, 1>;
+
 template<unsigned int SZ>
 constexpr auto BoxFilter()
 {
@@ -101,6 +131,24 @@ constexpr auto StackBlurFilter()
 	return krnl;
 }
 
+// Row of Pascal's triangle, the Gaussian approximation of Burt & Adelson pyramids for SZ = 5
+template<unsigned int SZ>
+constexpr auto BinomialFilter()
+{
+	constexpr int S = (SZ % 2 != 0) ? SZ : SZ + 1;
+	Eigen::Matrix<float, S, 1> krnl;
+
+	float coeff = 1.0f;
+	for(int i = 0; i < S; i++)
+	{
+		krnl[i] = coeff/float(1 << (S - 1));
+		coeff = coeff*(S - 1 - i)/(i + 1);
+	}
+
+	return krnl;
+}
+
+// Normalized Gaussian sampled at whole pixel offsets -S/2 ... S/2, tap S/2 is the center
 template<unsigned int SZ>
 constexpr auto GaussFilter(float sigma)
 {
@@ -113,8 +161,7 @@ constexpr auto GaussFilter(float sigma)
 	float sum = 0.0f;
 	for(int i = 0; i < S; i++)
 	{
-		const float s = (i - S) + 1;
-		const float x = -(s/2.0f) + 0.5f;
+		const float x = i - S/2;
 		krnl[i] = (1.0f/std::sqrt(2.0f*M_PI*sigmaSq)) * std::exp(-(x*x)/twoSigmaSq);
 		sum += krnl[i];
 	}
@@ -3,42 +3,234 @@
 
 #include "Image.h"
 #include "Sampler.h"
+#include "Dispatch.h"
+#include "FixedKernel.h"
+#include "KernelDecomposition.h"
+#include "FFT.h"
 #include <eigen3/Eigen/StdVector>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
 
 namespace cvpp
 {
 
+namespace detail
+{
+constexpr int RowBlockSize = 64;
+
+// Calls fn(y0, y1) on blocks of rows in parallel.
+template<typename Fn>
+void ForEachRowBlock(int height, int blockSize, Fn&& fn)
+{
+	const int blocks = (height + blockSize - 1)/blockSize;
+
+#pragma omp parallel for
+	for(int b = 0; b < blocks; b++)
+		fn(b*blockSize, std::min(height, (b + 1)*blockSize));
+}
+
+template<typename Fn>
+void ForEachRowBlock(int height, Fn&& fn)
+{
+	ForEachRowBlock(height, RowBlockSize, fn);
+}
+
+// Calls fn with a channel count of up to 4 as a std::integral_constant, so loops over
+// the channels of a pixel unroll, and with larger counts as an int.
+template<typename Fn>
+void WithComponents(int comps, Fn&& fn)
+{
+	assert(comps >= 1);
+
+	switch(comps)
+	{
+	case 1: fn(std::integral_constant<int, 1>()); break;
+	case 2: fn(std::integral_constant<int, 2>()); break;
+	case 3: fn(std::integral_constant<int, 3>()); break;
+	case 4: fn(std::integral_constant<int, 4>()); break;
+	default: fn(comps); break;
+	}
+}
+
+// Streams the windows of rows y - halfSize ... y + halfSize for y0 <= y < y1 through
+// a ring of buffers so every input row is fetched once: fetch(row, dst) fills one
+// buffer, fn(y, rows) gets the pointers to the window of y in top to bottom order.
+template<typename Elem = float, typename Fetch, typename Fn>
+void SlidingRows(int y0, int y1, unsigned int size, size_t rowSize, Fetch&& fetch, Fn&& fn)
+{
+	const int halfSize = size/2;
+	std::vector<Elem> ring(size*rowSize);
+	std::vector<const Elem*> rows(size);
+	auto slot = [&](int row) { return &ring[mod(row, int(size))*rowSize]; };
+
+	for(int y = y0 - halfSize; y < y0 + halfSize; y++)
+		fetch(y, slot(y));
+
+	for(int y = y0; y < y1; y++)
+	{
+		fetch(y + halfSize, slot(y + halfSize));
+		for(int k = 0; k < size; k++)
+			rows[k] = slot(y - halfSize + k);
+
+		fn(y, rows.data());
+	}
+}
+
+// Same for the output rows y0 <= y < y1 of an image decimated by step: the window
+// of y is centered at input row y*step and rows shared with the previous window are kept.
+template<typename Elem = float, typename Fetch, typename Fn>
+void SlidingRowsDecimated(int y0, int y1, int step, unsigned int size, size_t rowSize, Fetch&& fetch, Fn&& fn)
+{
+	const int halfSize = size/2;
+	std::vector<Elem> ring(size*rowSize);
+	std::vector<int> stored(size, std::numeric_limits<int>::min());
+	std::vector<const Elem*> rows(size);
+
+	for(int y = y0; y < y1; y++)
+	{
+		for(int k = 0; k < size; k++)
+		{
+			const int row = y*step - halfSize + k;
+			const int s = mod(row, int(size));
+			if(stored[s] != row)
+			{
+				fetch(row, &ring[s*rowSize]);
+				stored[s] = row;
+			}
+
+			rows[k] = &ring[s*rowSize];
+		}
+
+		fn(y, rows.data());
+	}
+}
+
+// Splits a padded row of pixels into factor phases of phaseSize floats, phase f holds
+// pixels f, f + factor, f + 2*factor, ... so that every tap of a convolution which keeps
+// every factor-th pixel reads a contiguous run of a phase.
+inline void SplitPhases(const float* in, float* out, size_t pixels, unsigned int comps, unsigned int factor, size_t phaseSize)
+{
+	WithComponents(comps, [&](auto C) {
+		const int Comps = C;
+		const size_t step = size_t(factor)*Comps;
+		for(unsigned int f = 0; f < factor; f++)
+		{
+			const float* src = in + f*Comps;
+			float* dst = out + f*phaseSize;
+			for(; src < in + pixels*Comps; src += step, dst += Comps)
+				for(int c = 0; c < Comps; c++)
+					dst[c] = src[c];
+		}
+	});
+}
+
+// Tap k of output pixel p reads input pixel p*factor + k, that is pixel p + k/factor of
+// phase k % factor. Writes the start of that run for the taps of one row of the kernel.
+inline void PhaseTaps(const float* phases, const float** taps, unsigned int size, unsigned int comps, unsigned int factor,
+					  size_t phaseSize)
+{
+	for(unsigned int k = 0; k < size; k++)
+		taps[k] = phases + (k % factor)*phaseSize + (k/factor)*comps;
+}
+
+template<typename K>
+std::vector<float> KernelCoefficients(const K& kernel, unsigned int size)
+{
+	std::vector<float> coeffs(size);
+	for(unsigned int k = 0; k < size; k++)
+		coeffs[k] = kernel[k];
+
+	return coeffs;
+}
+
+template<typename K>
+std::vector<float> KernelCoefficients2D(const K& kernel, unsigned int size)
+{
+	std::vector<float> coeffs(size*size);
+	for(unsigned int r = 0; r < size; r++)
+		for(unsigned int c = 0; c < size; c++)
+			coeffs[r*size + c] = kernel(r, c);
+
+	return coeffs;
+}
+
+// Kernel in fixed point for 8 bit images: coefficient q[i] stands for q[i]/2^shift.
+// The shift is the largest one that keeps every coefficient in 16 bit and every sum
+// in 32 bit, the rounding of the largest coefficient absorbs the rounding error of
+// the kernel sum so flat regions stay flat.
+// Before the final rounding a result is off by at most maxError = 255*sum|k[i] - q[i]/2^shift|
+// steps, so the fixed point output is within maxError + 0.5 steps of the exact value. The
+// float path truncates instead and stays below the exact value by less than one step.
+struct FixedPointKernel
+{
+	std::vector<int16_t> coefficients;
+	unsigned int shift = 0;
+	float maxError = 0.0f;
+};
+
+// Kernels are only used in fixed point if maxError stays below this
+constexpr float MaxFixedPointError = 0.5f;
+
+FixedPointKernel QuantizeKernel(const std::vector<float>& kernel);
+
+// Convolution on 8 bit rows with rowCount x rowTaps taps for 2D, horizontal (rowCount = 1)
+// and vertical (rowTaps = 1) kernels, see KernelTable::convolveU8.
+inline void ConvoluteFixedPoint(const SamplerView<uint8_t>& sampler, const FixedPointKernel& kernel,
+								unsigned int rowCount, unsigned int rowTaps, CPUImage<uint8_t>& out)
+{
+	const int halfTaps = rowTaps/2;
+	const int w = out.getWidth();
+	const int comps = out.getComponents();
+	const size_t rowSize = size_t(w)*comps;
+	const auto& kernels = Dispatch::getKernels();
+
+	ForEachRowBlock(out.getHeight(), [&](int y0, int y1) {
+		SlidingRows<uint8_t>(y0, y1, rowCount, rowSize + 2*halfTaps*comps,
+			[&](int y, uint8_t* dst) { sampler.sampleRowTexels(y, -halfTaps, w + halfTaps, dst); },
+			[&](int y, const uint8_t* const* rows) {
+				kernels.convolveU8(rows, out.get(0, y), rowSize, kernel.coefficients.data(), rowCount, rowTaps, comps, kernel.shift);
+			});
+	});
+}
+}
+
 template<typename T, typename K>
 CPUImage<T> Convolute2D(const SamplerView<T>& sampler, const K& kernel, unsigned int size)
 {
+	assert(size % 2 != 0 && "A kernel needs an odd size!");
+
 	const CPUImage<T>& in = *sampler.getImage();
 	CPUImage<T> out(in.getWidth(), in.getHeight(), in.getComponents());
 	const int halfSize = size/2;
+	const int w = in.getWidth();
+	const int comps = in.getComponents();
+	const size_t rowSize = size_t(w)*comps;
+	const size_t paddedSize = rowSize + 2*halfSize*comps;
 
-#pragma omp parallel for
-	for(int y = 0; y < in.getHeight(); y++)
+	const auto coeffs = detail::KernelCoefficients2D(kernel, size);
+	const auto& kernels = Dispatch::getKernels();
+
+	if constexpr(std::is_same_v<T, uint8_t>)
 	{
-		const size_t yoff = y*in.getWidth();
-		for(int x = 0; x < in.getWidth(); x++)
+		const auto fixed = detail::QuantizeKernel(coeffs);
+		if(fixed.maxError < detail::MaxFixedPointError)
 		{
-			const size_t xoff = (yoff+x)*in.getComponents();
-			Eigen::Vector4f sum(0, 0, 0, 0);
-			for(int kx = -halfSize; kx <= halfSize; kx++)
-			{
-				for(int ky = -halfSize; ky <= halfSize; ky++)
-				{
-					sum += kernel(ky + halfSize, kx + halfSize) * sampler.sample(x + kx, y + ky);
-				}
-			}
-
-			auto* outPtr = &out.getData()[xoff];
-			for(int c = 0; c < in.getComponents(); c++)
-			{
-				outPtr[c] = FloatToColor<T>(sum[c]);
-			}
+			detail::ConvoluteFixedPoint(sampler, fixed, size, size, out);
+			return out;
 		}
 	}
 
+	detail::ForEachRowBlock(in.getHeight(), [&](int y0, int y1) {
+		std::vector<float> result(rowSize);
+		detail::SlidingRows(y0, y1, size, paddedSize,
+			[&](int y, float* dst) { sampler.sampleRow(y, -halfSize, w + halfSize, dst); },
+			[&](int y, const float* const* rows) {
+				kernels.convolve2D(rows, result.data(), rowSize, coeffs.data(), size, comps);
+				detail::FromFloat(result.data(), out.get(0, y), rowSize);
+			});
+	});
+
 	return out;
 }
 
@@ -85,20 +277,398 @@ CPUImage<T> NonLinearConv2D(const SamplerView<T>& sampler, unsigned int size, Fn
 	return NonLinearConv2D<Stride>(sampler, size, fn, [](auto, auto, auto){});
 }
 
-template<typename T, int Size>
-CPUImage<T> Convolute2D(const SamplerView<T>& sampler, const Eigen::Matrix<float, Size, Size>& kernel)
+// Reduces the size x size patches centered at every size-th pixel without writing
+// an image: fn(kx, ky, value, acc) folds the samples of a patch into acc, which
+// starts at zero, and fin(x, y, acc) gets the result of the patch centered at (x, y).
+// Rows of patches are processed in parallel, each reads its rows once into a band.
+template<typename T, typename Fn, typename Finisher>
+void PatchReduce(const SamplerView<T>& sampler, unsigned int size, Fn fn, Finisher fin)
 {
-	static_assert(Size % 2 != 0, "A kernel needs an odd size!");
-	return Convolute2D(sampler, kernel, Size);
+	const CPUImage<T>& in = *sampler.getImage();
+	const int halfSize = size/2;
+	const int w = in.getWidth();
+	const int comps = in.getComponents();
+	const int tilesX = (w + size - 1)/size;
+	const int tilesY = (in.getHeight() + size - 1)/size;
+	const int paddedW = (tilesX - 1)*size + 2*halfSize + 1;
+	const size_t rowSize = size_t(paddedW)*comps;
+
+#pragma omp parallel for
+	for(int ty = 0; ty < tilesY; ty++)
+	{
+		const int y = ty*size;
+		// Windows span 2*halfSize + 1 rows, one more than size for even sizes
+		std::vector<float> band((2*halfSize + 1)*rowSize);
+		for(int r = 0; r <= 2*halfSize; r++)
+			sampler.sampleRow(y - halfSize + r, -halfSize, paddedW - halfSize, &band[r*rowSize]);
+
+		for(int tx = 0; tx < tilesX; tx++)
+		{
+			const int x = tx*size;
+			Eigen::Vector4f acc(0, 0, 0, 0);
+			for(int kx = -halfSize; kx <= halfSize; kx++)
+			{
+				for(int ky = -halfSize; ky <= halfSize; ky++)
+				{
+					const float* px = &band[(ky + halfSize)*rowSize + size_t(x + kx + halfSize)*comps];
+					Eigen::Vector4f v(0, 0, 0, 0);
+					for(int c = 0; c < comps; c++)
+						v[c] = px[c];
+
+					fn(kx, ky, v, acc);
+				}
+			}
+
+			fin(uint32_t(x), uint32_t(y), acc);
+		}
+	}
+}
+
+// Same as above, returning the reduced values of all patches in row major order.
+template<typename T, typename Fn>
+std::vector<Eigen::Vector4f> PatchReduce(const SamplerView<T>& sampler, unsigned int size, Fn fn)
+{
+	const CPUImage<T>& in = *sampler.getImage();
+	const int tilesX = (in.getWidth() + size - 1)/size;
+	const int tilesY = (in.getHeight() + size - 1)/size;
+
+	std::vector<Eigen::Vector4f> result(size_t(tilesX)*tilesY);
+	PatchReduce(sampler, size, fn, [&](uint32_t x, uint32_t y, const Eigen::Vector4f& acc) {
+		result[(y/size)*tilesX + x/size] = acc;
+	});
+
+	return result;
 }
 
+namespace detail
+{
+// Sum of separable terms vertical[i] * horizontal[i]^T in a single sweep: each
+// block of output rows keeps a ring of 'size' horizontally filtered rows per term,
+// so every input row is read and filtered once and the vertical pass consumes
+// it while it is still in cache. Rows stay in float between the passes.
+// With a factor > 1 only every factor-th pixel of every factor-th row is computed
+// and the output is smaller by that factor, rounded up.
+template<typename T>
+CPUImage<T> ConvoluteSeparableTerms(const SamplerView<T>& sampler, const std::vector<std::vector<float>>& horizontal,
+									const std::vector<std::vector<float>>& vertical, unsigned int factor = 1)
+{
+	const CPUImage<T>& in = *sampler.getImage();
+	CPUImage<T> out((in.getWidth() + factor - 1)/factor, (in.getHeight() + factor - 1)/factor, in.getComponents());
+	const unsigned int size = horizontal.front().size();
+	const unsigned int terms = horizontal.size();
+	const int halfSize = size/2;
+	const int w = out.getWidth();
+	const int comps = in.getComponents();
+	const size_t rowSize = size_t(w)*comps;
+	const int inputEnd = (w - 1)*factor + halfSize + 1;
+	const size_t paddedPixels = inputEnd + halfSize;
+	const size_t phaseSize = (paddedPixels + factor - 1)/factor*comps;
+	const auto& kernels = Dispatch::getKernels();
+
+	ForEachRowBlock(out.getHeight(), [&](int y0, int y1) {
+		std::vector<float> row(paddedPixels*comps), phases(factor > 1 ? factor*phaseSize : 0);
+		std::vector<float> result(rowSize), acc(rowSize);
+		std::vector<const float*> termRows(size), taps(size);
+
+		SlidingRowsDecimated(y0, y1, factor, size, terms*rowSize,
+			[&](int y, float* dst) {
+				sampler.sampleRow(y, -halfSize, inputEnd, row.data());
+				if(factor > 1)
+				{
+					SplitPhases(row.data(), phases.data(), paddedPixels, comps, factor, phaseSize);
+					PhaseTaps(phases.data(), taps.data(), size, comps, factor, phaseSize);
+				}
+
+				for(unsigned int t = 0; t < terms; t++)
+				{
+					if(factor == 1)
+						kernels.convolveRow(row.data(), dst + t*rowSize, rowSize, horizontal[t].data(), size, comps);
+					else
+						kernels.convolveColumns(taps.data(), dst + t*rowSize, rowSize, horizontal[t].data(), size);
+				}
+			},
+			[&](int y, const float* const* rows) {
+				for(unsigned int t = 0; t < terms; t++)
+				{
+					for(unsigned int k = 0; k < size; k++)
+						termRows[k] = rows[k] + t*rowSize;
+
+					kernels.convolveColumns(termRows.data(), t == 0 ? acc.data() : result.data(), rowSize, vertical[t].data(), size);
+					if(t > 0)
+						kernels.add(acc.data(), result.data(), acc.data(), rowSize);
+				}
+
+				FromFloat(acc.data(), out.get(0, y), rowSize);
+			});
+	});
+
+	return out;
+}
+
+template<typename T, typename K>
+CPUImage<T> ConvoluteSeparable(const SamplerView<T>& sampler, const K& kernel, unsigned int size, unsigned int factor = 1)
+{
+	assert(size % 2 != 0 && "A kernel needs an odd size!");
+
+	const auto coeffs = KernelCoefficients(kernel, size);
+	return ConvoluteSeparableTerms(sampler, {coeffs}, {coeffs}, factor);
+}
+}
+
+// Correlation by overlap-save on square tiles: every tile is transformed, multiplied
+// with the kernel spectrum and transformed back, the border of size - 1 pixels
+// spoiled by the cyclic wrap is dropped. The kernel is real, so two channels (or
+// the same channel of two tiles) share one complex transform as real and imaginary part.
+template<typename T>
+CPUImage<T> ConvoluteFFT(const SamplerView<T>& sampler, const Eigen::MatrixXf& kernel)
+{
+	assert(kernel.rows() == kernel.cols() && kernel.rows() % 2 != 0 && "Wrong size of kernel!");
+
+	const CPUImage<T>& in = *sampler.getImage();
+	CPUImage<T> out(in.getWidth(), in.getHeight(), in.getComponents());
+	const int size = kernel.rows();
+	const int halfSize = size/2;
+	const int w = in.getWidth();
+	const int h = in.getHeight();
+	const int comps = in.getComponents();
+
+	const int n = FFTTileSize(w, h, size);
+	const size_t area = size_t(n)*n;
+	const int valid = n - size + 1;
+	const int tilesX = (w + valid - 1)/valid;
+	const int tilesY = (h + valid - 1)/valid;
+	const FFT fft(n);
+
+	// Mirrored to turn the cyclic convolution into a correlation and scaled to
+	// normalize the inverse transform.
+	std::vector<float> spectrum(2*area);
+	float* kernelRe = spectrum.data();
+	float* kernelIm = spectrum.data() + area;
+	for(int ky = -halfSize; ky <= halfSize; ky++)
+		for(int kx = -halfSize; kx <= halfSize; kx++)
+			kernelRe[mod(-ky, n)*n + mod(-kx, n)] = kernel(ky + halfSize, kx + halfSize)/float(area);
+
+	fft.forward2D(kernelRe, kernelIm);
+
+	// Jobs are the channels of all tiles, job 2*p goes into the real and 2*p + 1 into the imaginary part
+	const int jobs = tilesX*tilesY*comps;
+	const int pairs = (jobs + 1)/2;
+
+#pragma omp parallel
+	{
+		std::vector<float> tile(2*area);
+		std::vector<float> row(size_t(n)*comps);
+		float* planes[2] = {tile.data(), tile.data() + area};
+
+		auto forJobs = [&](int p, auto&& fn) {
+			for(int part = 0; part < 2 && 2*p + part < jobs; part++)
+			{
+				const int job = 2*p + part;
+				const int t = job/comps;
+				fn(planes[part], (t % tilesX)*valid, (t/tilesX)*valid, job % comps);
+			}
+		};
+
+#pragma omp for schedule(dynamic)
+		for(int p = 0; p < pairs; p++)
+		{
+			if(2*p + 1 == jobs)
+				std::fill(planes[1], planes[1] + area, 0.0f);
+
+			forJobs(p, [&](float* plane, int x0, int y0, int c) {
+				for(int r = 0; r < n; r++)
+				{
+					sampler.sampleRow(y0 - halfSize + r, x0 - halfSize, x0 - halfSize + n, row.data());
+					float* dst = plane + size_t(r)*n;
+					for(int i = 0; i < n; i++)
+						dst[i] = row[i*comps + c];
+				}
+			});
+
+			fft.forward2D(planes[0], planes[1]);
+
+			float* re = planes[0];
+			float* im = planes[1];
+			for(size_t i = 0; i < area; i++)
+			{
+				const float r = re[i]*kernelRe[i] - im[i]*kernelIm[i];
+				im[i] = re[i]*kernelIm[i] + im[i]*kernelRe[i];
+				re[i] = r;
+			}
+
+			fft.inverse2D(planes[0], planes[1]);
+
+			forJobs(p, [&](const float* plane, int x0, int y0, int c) {
+				const int rows = std::min(valid, h - y0);
+				const int cols = std::min(valid, w - x0);
+				for(int r = 0; r < rows; r++)
+				{
+					const float* src = plane + size_t(r + halfSize)*n + halfSize;
+					T* dst = out.get(x0, y0 + r) + c;
+					for(int i = 0; i < cols; i++)
+						dst[i*comps] = FloatToColor<T>(src[i]);
+				}
+			});
+		}
+	}
+
+	return out;
+}
+
+// Kernels of low rank, like box, Gaussian, Sobel or Scharr filters, are automatically
+// applied as a sum of separable passes, large full rank kernels by FFT.
 template<typename T>
 CPUImage<T> Convolute2D(const SamplerView<T>& sampler, const Eigen::MatrixXf& kernel)
 {
 	assert(kernel.rows() == kernel.cols() && "Wrong size of kernel!");
+
+	const auto decomposition = DecomposeKernel(kernel);
+	if(decomposition.isSeparable())
+	{
+		std::vector<std::vector<float>> horizontal, vertical;
+		for(unsigned int i = 0; i < decomposition.getRank(); i++)
+		{
+			horizontal.push_back(detail::KernelCoefficients(decomposition.horizontal[i], kernel.rows()));
+			vertical.push_back(detail::KernelCoefficients(decomposition.vertical[i], kernel.rows()));
+		}
+
+		return detail::ConvoluteSeparableTerms(sampler, horizontal, vertical);
+	}
+
+	if(kernel.rows() >= FFTConvolutionThreshold)
+		return ConvoluteFFT(sampler, kernel);
+
 	return Convolute2D(sampler, kernel, kernel.rows());
 }
 
+template<typename T, int Size>
+CPUImage<T> Convolute2D(const SamplerView<T>& sampler, const Eigen::Matrix<float, Size, Size>& kernel)
+{
+	static_assert(Size % 2 != 0, "A kernel needs an odd size!");
+	return Convolute2D(sampler, Eigen::MatrixXf(kernel));
+}
+
+namespace detail
+{
+// One output row of a kernel of size K::Size from a window of Size rows padded for Size.
+// Every nonzero tap is a row offset to its column, so the dispatched column kernel
+// evaluates the whole row with vectors and zero taps cost nothing.
+template<typename K, int Size>
+void EvaluateFixedKernelRow(const float* const* rows, float* dst, size_t count, unsigned int stride)
+{
+	constexpr auto& plan = FixedKernelPlan<K>::Value;
+	constexpr int Offset = (Size - K::Size)/2;
+
+	std::array<const float*, FixedKernelPlan<K>::Taps> taps;
+	for(int n = 0; n < plan.count; n++)
+	{
+		const int t = plan.taps[n];
+		taps[n] = rows[Offset + t/K::Size] + size_t(Offset + t % K::Size)*stride;
+	}
+
+	Dispatch::getKernels().convolveColumns(taps.data(), dst, count, plan.coefficients.data(), plan.count);
+}
+}
+
+template<typename T, typename K> requires IsFixedKernel<K>
+CPUImage<T> Convolute2D(const SamplerView<T>& sampler, const K&)
+{
+	const CPUImage<T>& in = *sampler.getImage();
+	CPUImage<T> out(in.getWidth(), in.getHeight(), in.getComponents());
+	const int halfSize = K::Size/2;
+	const int w = in.getWidth();
+	const unsigned int comps = in.getComponents();
+	const size_t rowSize = size_t(w)*comps;
+	const size_t paddedSize = rowSize + 2*halfSize*comps;
+
+	detail::ForEachRowBlock(in.getHeight(), [&](int y0, int y1) {
+		std::vector<float> result(rowSize);
+		detail::SlidingRows(y0, y1, K::Size, paddedSize,
+			[&](int y, float* dst) { sampler.sampleRow(y, -halfSize, w + halfSize, dst); },
+			[&](int y, const float* const* rows) {
+				detail::EvaluateFixedKernelRow<K, K::Size>(rows, result.data(), rowSize, comps);
+				detail::FromFloat(result.data(), out.get(0, y), rowSize);
+			});
+	});
+
+	return out;
+}
+
+// Several kernels on the same input in a single pass, output k belongs to kernel k.
+// Every window of rows is fetched once and all kernels are evaluated on it while
+// it is in cache, e.g. both gradients or all second derivatives of an image.
+template<typename T>
+std::vector<CPUImage<T>> ConvoluteMulti(const SamplerView<T>& sampler, const std::vector<Eigen::MatrixXf>& kernels)
+{
+	assert(!kernels.empty() && "No kernels given!");
+
+	const CPUImage<T>& in = *sampler.getImage();
+	const unsigned int size = kernels.front().rows();
+	const int halfSize = size/2;
+	const int w = in.getWidth();
+	const int comps = in.getComponents();
+	const size_t rowSize = size_t(w)*comps;
+	const size_t paddedSize = rowSize + 2*halfSize*comps;
+
+	std::vector<std::vector<float>> coeffs;
+	std::vector<CPUImage<T>> out;
+	for(const auto& k : kernels)
+	{
+		assert(k.rows() == size && k.cols() == size && size % 2 != 0 && "All kernels need the same odd size!");
+		coeffs.push_back(detail::KernelCoefficients2D(k, size));
+		out.emplace_back(in.getWidth(), in.getHeight(), in.getComponents());
+	}
+
+	const auto& dispatch = Dispatch::getKernels();
+
+	detail::ForEachRowBlock(in.getHeight(), [&](int y0, int y1) {
+		std::vector<float> result(rowSize);
+		detail::SlidingRows(y0, y1, size, paddedSize,
+			[&](int y, float* dst) { sampler.sampleRow(y, -halfSize, w + halfSize, dst); },
+			[&](int y, const float* const* rows) {
+				for(size_t k = 0; k < kernels.size(); k++)
+				{
+					dispatch.convolve2D(rows, result.data(), rowSize, coeffs[k].data(), size, comps);
+					detail::FromFloat(result.data(), out[k].get(0, y), rowSize);
+				}
+			});
+	});
+
+	return out;
+}
+
+// Compile time kernels of any odd sizes, all unrolled into the same loop over a row.
+template<typename T, typename... K> requires (sizeof...(K) > 0 && (IsFixedKernel<K> && ...))
+std::array<CPUImage<T>, sizeof...(K)> ConvoluteMulti(const SamplerView<T>& sampler, const K&...)
+{
+	constexpr size_t Count = sizeof...(K);
+	constexpr int Size = std::max({K::Size...});
+	constexpr int HalfSize = Size/2;
+
+	const CPUImage<T>& in = *sampler.getImage();
+	const int w = in.getWidth();
+	const unsigned int comps = in.getComponents();
+	const size_t rowSize = size_t(w)*comps;
+	const size_t paddedSize = rowSize + 2*HalfSize*comps;
+
+	std::array<CPUImage<T>, Count> out;
+	for(auto& o : out)
+		o = CPUImage<T>(in.getWidth(), in.getHeight(), in.getComponents());
+
+	detail::ForEachRowBlock(in.getHeight(), [&](int y0, int y1) {
+		std::vector<float> result(rowSize);
+		detail::SlidingRows(y0, y1, Size, paddedSize,
+			[&](int y, float* dst) { sampler.sampleRow(y, -HalfSize, w + HalfSize, dst); },
+			[&](int y, const float* const* rows) {
+				size_t k = 0;
+				((detail::EvaluateFixedKernelRow<K, Size>(rows, result.data(), rowSize, comps),
+				  detail::FromFloat(result.data(), out[k++].get(0, y), rowSize)), ...);
+			});
+	});
+
+	return out;
+}
+
 enum CONVOLUTION_TYPE
 {
 	HORIZONTAL,
@@ -108,37 +678,55 @@ enum CONVOLUTION_TYPE
 template<CONVOLUTION_TYPE Dir = HORIZONTAL, typename T, typename K>
 CPUImage<T> Convolute1D(const SamplerView<T>& sampler, const K& kernel, unsigned int size)
 {
+	assert(size % 2 != 0 && "A kernel needs an odd size!");
+
 	const CPUImage<T>& in = *sampler.getImage();
 	CPUImage<T> out(in.getWidth(), in.getHeight(), in.getComponents());
 	const int halfSize = size/2;
+	const int w = in.getWidth();
+	const int comps = in.getComponents();
+	const size_t rowSize = size_t(w)*comps;
 
-#pragma omp parallel for
-	for(int y = 0; y < in.getHeight(); y++)
+	const auto coeffs = detail::KernelCoefficients(kernel, size);
+	const auto& kernels = Dispatch::getKernels();
+
+	if constexpr(std::is_same_v<T, uint8_t>)
 	{
-		const size_t yoff = y*in.getWidth();
-		for(int x = 0; x < in.getWidth(); x++)
+		const auto fixed = detail::QuantizeKernel(coeffs);
+		if(fixed.maxError < detail::MaxFixedPointError)
 		{
-			const size_t xoff = (yoff+x)*in.getComponents();
-			Eigen::Vector4f sum(0, 0, 0, 0);
-			for(int k = -halfSize; k <= halfSize; k++)
-			{
-				if constexpr(Dir == HORIZONTAL)
-				{
-					sum += kernel[k + halfSize] * sampler.sample(x + k, y);
-				}
-				else
-				{
-					sum += kernel[k + halfSize] * sampler.sample(x, y + k);
-				}
-			}
+			if constexpr(Dir == HORIZONTAL)
+				detail::ConvoluteFixedPoint(sampler, fixed, 1, size, out);
+			else
+				detail::ConvoluteFixedPoint(sampler, fixed, size, 1, out);
 
-			auto* outPtr = &out.getData()[xoff];
-			for(int c = 0; c < in.getComponents(); c++)
+			return out;
+		}
+	}
+
+	detail::ForEachRowBlock(in.getHeight(), [&](int y0, int y1) {
+		std::vector<float> result(rowSize);
+
+		if constexpr(Dir == HORIZONTAL)
+		{
+			std::vector<float> row(rowSize + 2*halfSize*comps);
+			for(int y = y0; y < y1; y++)
 			{
-				outPtr[c] = FloatToColor<T>(sum[c]);
+				sampler.sampleRow(y, -halfSize, w + halfSize, row.data());
+				kernels.convolveRow(row.data(), result.data(), rowSize, coeffs.data(), size, comps);
+				detail::FromFloat(result.data(), out.get(0, y), rowSize);
 			}
 		}
-	}
+		else
+		{
+			detail::SlidingRows(y0, y1, size, rowSize,
+				[&](int y, float* dst) { sampler.sampleRow(y, 0, w, dst); },
+				[&](int y, const float* const* rows) {
+					kernels.convolveColumns(rows, result.data(), rowSize, coeffs.data(), size);
+					detail::FromFloat(result.data(), out.get(0, y), rowSize);
+				});
+		}
+	});
 
 	return out;
 }
@@ -155,25 +743,106 @@ CPUImage<T> Convolute1D(const SamplerView<T>& sampler, const Eigen::VectorXf& ke
 	return Convolute1D<Dir>(sampler, kernel, kernel.rows());
 }
 
+// Separable kernels run as one fused pass, see detail::ConvoluteSeparableTerms.
 template<typename T, typename K>
 auto ConvoluteSeparable(const T& sampler, const K& kernel, unsigned int size)
 {
-	auto r1 = Convolute1D<HORIZONTAL>(sampler, kernel, size);
-	return Convolute1D<VERTICAL>(T(r1), kernel, size);
+	return detail::ConvoluteSeparable(sampler, kernel, size);
 }
 
 template<typename T, int Rows, int Cols>
 auto ConvoluteSeparable(const T& sampler, const Eigen::Matrix<float, Rows, Cols>& kernel)
 {
-	auto r1 = Convolute1D<HORIZONTAL>(sampler, kernel, Rows);
-	return Convolute1D<VERTICAL>(T(r1), kernel, Rows);
+	return detail::ConvoluteSeparable(sampler, kernel, Rows);
 }
 
 template<typename T>
 auto ConvoluteSeparable(const T& sampler, const Eigen::VectorXf& kernel)
 {
-	auto r1 = Convolute1D<HORIZONTAL>(sampler, kernel, kernel.rows());
-	return Convolute1D<VERTICAL>(T(r1), kernel, kernel.rows());
+	return detail::ConvoluteSeparable(sampler, kernel, kernel.rows());
+}
+
+// Different kernels for both directions, e.g. a derivative across a smoothing filter.
+template<typename T>
+auto ConvoluteSeparable(const T& sampler, const Eigen::VectorXf& horizontal, const Eigen::VectorXf& vertical)
+{
+	assert(horizontal.rows() == vertical.rows() && horizontal.rows() % 2 != 0 && "Wrong size of kernel!");
+	return detail::ConvoluteSeparableTerms(sampler,
+		{detail::KernelCoefficients(horizontal, horizontal.rows())},
+		{detail::KernelCoefficients(vertical, vertical.rows())});
+}
+
+// Convolution followed by keeping every factor-th pixel of every factor-th row, e.g.
+// the blur and subsampling of a pyramid level. Only the retained samples are computed in
+// both directions, output pixel (x, y) is the kernel centered at input pixel (x*factor, y*factor).
+template<typename T, typename K>
+auto ConvoluteSeparableDecimated(const T& sampler, const K& kernel, unsigned int size, unsigned int factor)
+{
+	return detail::ConvoluteSeparable(sampler, kernel, size, factor);
+}
+
+template<typename T, int Rows, int Cols>
+auto ConvoluteSeparableDecimated(const T& sampler, const Eigen::Matrix<float, Rows, Cols>& kernel, unsigned int factor)
+{
+	return detail::ConvoluteSeparable(sampler, kernel, Rows, factor);
+}
+
+template<typename T>
+auto ConvoluteSeparableDecimated(const T& sampler, const Eigen::VectorXf& kernel, unsigned int factor)
+{
+	return detail::ConvoluteSeparable(sampler, kernel, kernel.rows(), factor);
+}
+
+template<typename T>
+CPUImage<T> Convolute2DDecimated(const SamplerView<T>& sampler, const Eigen::MatrixXf& kernel, unsigned int factor)
+{
+	assert(kernel.rows() == kernel.cols() && kernel.rows() % 2 != 0 && "Wrong size of kernel!");
+
+	const auto decomposition = DecomposeKernel(kernel);
+	const unsigned int size = kernel.rows();
+	if(decomposition.isSeparable())
+	{
+		std::vector<std::vector<float>> horizontal, vertical;
+		for(unsigned int i = 0; i < decomposition.getRank(); i++)
+		{
+			horizontal.push_back(detail::KernelCoefficients(decomposition.horizontal[i], size));
+			vertical.push_back(detail::KernelCoefficients(decomposition.vertical[i], size));
+		}
+
+		return detail::ConvoluteSeparableTerms(sampler, horizontal, vertical, factor);
+	}
+
+	const CPUImage<T>& in = *sampler.getImage();
+	CPUImage<T> out((in.getWidth() + factor - 1)/factor, (in.getHeight() + factor - 1)/factor, in.getComponents());
+	const int halfSize = size/2;
+	const int w = out.getWidth();
+	const int comps = in.getComponents();
+	const size_t rowSize = size_t(w)*comps;
+	const int inputEnd = (w - 1)*factor + halfSize + 1;
+	const size_t paddedPixels = inputEnd + halfSize;
+	const size_t phaseSize = (paddedPixels + factor - 1)/factor*comps;
+	const auto coeffs = detail::KernelCoefficients2D(kernel, size);
+
+	// The ring keeps rows split into phases, all taps of an output row are then
+	// evaluated in one pass over the kept pixels
+	detail::ForEachRowBlock(out.getHeight(), [&](int y0, int y1) {
+		std::vector<float> result(rowSize), row(paddedPixels*comps);
+		std::vector<const float*> taps(size*size);
+		detail::SlidingRowsDecimated(y0, y1, factor, size, factor*phaseSize,
+			[&](int y, float* dst) {
+				sampler.sampleRow(y, -halfSize, inputEnd, row.data());
+				detail::SplitPhases(row.data(), dst, paddedPixels, comps, factor, phaseSize);
+			},
+			[&](int y, const float* const* rows) {
+				for(unsigned int r = 0; r < size; r++)
+					detail::PhaseTaps(rows[r], &taps[r*size], size, comps, factor, phaseSize);
+
+				Dispatch::getKernels().convolveColumns(taps.data(), result.data(), rowSize, coeffs.data(), size*size);
+				detail::FromFloat(result.data(), out.get(0, y), rowSize);
+			});
+	});
+
+	return out;
 }
 
 }
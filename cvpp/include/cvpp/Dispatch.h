@@ -0,0 +1,87 @@
+#ifndef __DISPATCH_H__
+#define __DISPATCH_H__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cvpp
+{
+
+// Hot loops of the CPU backend are compiled once per instruction set
+// (see src/kernels/Kernels.cpp) and the best table for the running CPU is
+// picked on first use. Setting the environment variable CVPP_ISA to
+// "generic", "sse4.2", "avx2" or "avx512" caps the selected level. Unknown
+// values are reported on stderr and select the generic kernels.
+namespace Dispatch
+{
+
+enum ISA_LEVEL
+{
+	GENERIC,
+	SSE42,
+	AVX2,
+	AVX512,
+	ISA_COUNT
+};
+
+struct KernelTable
+{
+	ISA_LEVEL level;
+
+	// Color conversion, matches ColorToFloat/FloatToColor
+	void (*u8ToFloat)(const uint8_t* in, float* out, size_t count);
+	void (*u16ToFloat)(const uint16_t* in, float* out, size_t count);
+	void (*floatToU8)(const float* in, uint8_t* out, size_t count);
+	void (*floatToU16)(const float* in, uint16_t* out, size_t count);
+	void (*grayscale)(const float* in, float* out, size_t pixels, unsigned int comps, const float* weights);
+
+	// Element wise arithmetic
+	void (*add)(const float* a, const float* b, float* out, size_t count);
+	void (*sub)(const float* a, const float* b, float* out, size_t count);
+	void (*mul)(const float* a, const float* b, float* out, size_t count);
+	void (*div)(const float* a, const float* b, float* out, size_t count);
+	// out[i] = e^in[i] within a few ulp
+	void (*exp)(const float* in, float* out, size_t count);
+
+	// Reductions
+	double (*sum)(const float* in, size_t count);
+	void (*minMax)(const float* in, size_t count, float& min, float& max);
+
+	// out[i] = sum_k kernel[k]*in[i + k*stride]
+	void (*convolveRow)(const float* in, float* out, size_t count, const float* kernel, unsigned int size, unsigned int stride);
+	// out[i] = sum_k kernel[k]*rows[k][i]
+	void (*convolveColumns)(const float* const* rows, float* out, size_t count, const float* kernel, unsigned int size);
+	// out[i] = sum_ky sum_kx kernel[ky*size + kx]*rows[ky][i + kx*stride]
+	void (*convolve2D)(const float* const* rows, float* out, size_t count, const float* kernel, unsigned int size, unsigned int stride);
+	// Fixed point version of the above on 8 bit rows, tap t = r*rowTaps + j reads rows[r][i + j*stride]:
+	// out[i] = saturate((sum_t kernel[t]*tap + 2^(shift - 1)) >> shift)
+	void (*convolveU8)(const uint8_t* const* rows, uint8_t* out, size_t count, const int16_t* kernel, unsigned int rowCount,
+						unsigned int rowTaps, unsigned int stride, unsigned int shift);
+
+	// Bilinear interpolation of 8 bit samples with 16 bit fixed point weights, p = in + offsets[i]:
+	// out[i] = (w0*p[0] + w1*p[step] + w2*p[stride] + w3*p[stride + step] + 2^(shift - 1)) >> shift,
+	// weights[2*fractions[i]] packs w0 | w1 << 16 and the entry after it w2 | w3 << 16. The weights
+	// need to sum to 2^shift. Reads up to 3 bytes past p[stride + step].
+	void (*bilinearU8)(const uint8_t* in, const int32_t* offsets, const uint16_t* fractions, const int32_t* weights,
+						uint8_t* out, size_t count, unsigned int step, size_t stride, unsigned int shift);
+
+	// Radix-2 butterfly on split complex rows: t = w*b, b = a - t, a = a + t
+	void (*butterfly)(float* aRe, float* aIm, float* bRe, float* bIm, size_t count, float wRe, float wIm);
+};
+
+// The table selected for this process.
+const KernelTable& getKernels();
+
+// The table for a specific level or nullptr if it was not compiled in or the CPU lacks support.
+const KernelTable* getKernels(ISA_LEVEL level);
+
+ISA_LEVEL getISA();
+const char* getISAName(ISA_LEVEL level);
+
+// Parses a CVPP_ISA value, ignoring case and '.', '_' or '-'. Returns false for unknown names.
+bool parseISAName(const char* name, ISA_LEVEL& level);
+
+}
+}
+
+#endif
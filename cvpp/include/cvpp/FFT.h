@@ -0,0 +1,53 @@
+#ifndef __FFT_H__
+#define __FFT_H__
+
+#include <cstddef>
+#include <vector>
+
+namespace cvpp
+{
+
+// Radix-2 FFT of square blocks of size x size complex values, stored as separate
+// planes of real and imaginary parts in row major order. The transform along the
+// columns runs its butterflies on whole rows, which keeps every step a contiguous
+// vector loop (Dispatch::KernelTable::butterfly). The rows are handled the same
+// way after a transposition.
+// Transforms are unnormalized, a forward and inverse transform scale the data by size^2.
+class FFT
+{
+public:
+	FFT() = default;
+	explicit FFT(size_t size);
+
+	size_t getSize() const { return m_size; }
+
+	// The spectrum is left transposed, which saves a transposition per direction
+	// and does not matter for pointwise products as long as all operands are
+	// produced by forward2D and consumed by inverse2D.
+	void forward2D(float* re, float* im) const;
+	void inverse2D(float* re, float* im) const;
+
+	static size_t NextPowerOfTwo(size_t n);
+
+private:
+	void transformColumns(float* re, float* im, bool inverse) const;
+	void transpose(float* data) const;
+
+	size_t m_size = 0;
+	std::vector<float> m_twiddlesRe;
+	std::vector<float> m_twiddlesIm;
+	std::vector<unsigned int> m_reversed;
+};
+
+// Picks the power of two tile size for an overlap-save convolution of a w x h
+// image that needs the least work in total. Every tile yields
+// (size - kernelSize + 1)^2 output pixels.
+unsigned int FFTTileSize(unsigned int w, unsigned int h, unsigned int kernelSize);
+
+// Kernel size from which Convolute2D switches from the direct sum to the FFT,
+// measured with 1 and 3 channel float images up to 2048x2048.
+constexpr unsigned int FFTConvolutionThreshold = 19;
+
+}
+
+#endif
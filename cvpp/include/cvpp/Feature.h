@@ -1,7 +1,10 @@
 #ifndef __FEATURE_H__
 #define __FEATURE_H__
 
+#include "Image.h"
+
 #include <Eigen/StdVector>
+#include <algorithm>
 
 namespace cvpp
 {
@@ -9,8 +12,83 @@ struct Feature
 {
 	unsigned int x = -1, y = -1;
 	float scale = 0.0f;
+	float response = 0.0f;
 };
 
+namespace detail
+{
+// Stronger responses first, ties in row major order so selections are deterministic
+inline bool StrongerFeature(const Feature& a, const Feature& b)
+{
+	if(a.response != b.response)
+		return a.response > b.response;
+
+	return a.y != b.y ? a.y < b.y : a.x < b.x;
+}
+
+// Moves the count strongest features to the front of [first, last) in order
+template<typename It>
+It PartitionStrongest(It first, It last, size_t count)
+{
+	const It end = first + std::min<size_t>(count, last - first);
+	std::nth_element(first, end, last, StrongerFeature);
+	std::sort(first, end, StrongerFeature);
+	return end;
+}
+}
+
+// The count strongest features, strongest first. Selection is linear in the number of
+// features and only the selected ones are sorted.
+inline std::vector<Feature> SelectStrongest(std::vector<Feature> features, size_t count)
+{
+	features.resize(detail::PartitionStrongest(features.begin(), features.end(), count) - features.begin());
+	return features;
+}
+
+// The count strongest features of every cellSize x cellSize cell of a width x height
+// image, which spreads them evenly over it. Features are bucketed by cell with a
+// counting sort, cells select in parallel and come out in row major order. Features
+// outside the image, e.g. default constructed ones, are dropped.
+inline std::vector<Feature> SelectStrongestPerCell(const std::vector<Feature>& features, unsigned int width, unsigned int height,
+												   unsigned int cellSize, size_t count)
+{
+	assert(cellSize > 0 && "Cells need a size!");
+
+	const unsigned int cellsX = (width + cellSize - 1)/cellSize;
+	const unsigned int cellsY = (height + cellSize - 1)/cellSize;
+	const int cells = cellsX*cellsY;
+	auto cellOf = [&](const Feature& f) { return f.x < width && f.y < height ? int((f.y/cellSize)*cellsX + f.x/cellSize) : -1; };
+
+	std::vector<size_t> offsets(cells + 1, 0);
+	for(const auto& f : features)
+		if(const int c = cellOf(f); c >= 0)
+			offsets[c + 1]++;
+	for(int c = 0; c < cells; c++)
+		offsets[c + 1] += offsets[c];
+
+	std::vector<Feature> bucketed(offsets[cells]);
+	std::vector<size_t> next(offsets.begin(), offsets.end() - 1);
+	for(const auto& f : features)
+		if(const int c = cellOf(f); c >= 0)
+			bucketed[next[c]++] = f;
+
+	std::vector<size_t> selected(cells);
+
+	#pragma omp parallel for schedule(dynamic)
+	for(int c = 0; c < cells; c++)
+	{
+		auto first = bucketed.begin() + offsets[c];
+		selected[c] = detail::PartitionStrongest(first, bucketed.begin() + offsets[c + 1], count) - first;
+	}
+
+	std::vector<Feature> result;
+	result.reserve(std::min(features.size(), cells*count));
+	for(int c = 0; c < cells; c++)
+		result.insert(result.end(), bucketed.begin() + offsets[c], bucketed.begin() + offsets[c] + selected[c]);
+
+	return result;
+}
+
 template<typename T>
 void MarkFeatures(CPUImage<T>& img, const Eigen::Vector4f& color, const std::vector<Feature>& features)
 {
@@ -0,0 +1,78 @@
+#ifndef __FIXED_KERNEL_H__
+#define __FIXED_KERNEL_H__
+
+#include <array>
+#include <utility>
+
+namespace cvpp
+{
+
+// Square kernel with coefficients known at compile time, in row major order.
+// Convolute2D only evaluates its nonzero taps.
+template<int S, int... C>
+struct FixedKernel
+{
+	static_assert(S % 2 != 0, "A kernel needs an odd size!");
+	static_assert(sizeof...(C) == S*S, "Wrong number of coefficients!");
+
+	static constexpr int Size = S;
+	static constexpr std::array<float, S*S> Coefficients = {float(C)...};
+
+	constexpr float operator()(int r, int c) const { return Coefficients[r*S + c]; }
+};
+
+template<typename K>
+struct TransposedKernel
+{
+	static constexpr int Size = K::Size;
+	static constexpr std::array<float, Size*Size> Coefficients = []() {
+		std::array<float, Size*Size> c{};
+		for(int r = 0; r < Size; r++)
+			for(int col = 0; col < Size; col++)
+				c[col*Size + r] = K::Coefficients[r*Size + col];
+		return c;
+	}();
+
+	constexpr float operator()(int r, int c) const { return Coefficients[r*Size + c]; }
+};
+
+template<typename K>
+concept IsFixedKernel = requires { K::Size; K::Coefficients; };
+
+namespace detail
+{
+
+// The nonzero taps of a kernel, tap t reads row t/Size and column t%Size
+template<typename K>
+struct FixedKernelPlan
+{
+	static constexpr int Taps = K::Size*K::Size;
+
+	struct Plan
+	{
+		int count = 0;
+		std::array<int, Taps> taps{};
+		std::array<float, Taps> coefficients{};
+	};
+
+	static constexpr Plan make()
+	{
+		Plan p;
+		for(int t = 0; t < Taps; t++)
+		{
+			if(K::Coefficients[t] == 0.0f)
+				continue;
+
+			p.taps[p.count] = t;
+			p.coefficients[p.count++] = K::Coefficients[t];
+		}
+		return p;
+	}
+
+	static constexpr Plan Value = make();
+};
+
+}
+}
+
+#endif
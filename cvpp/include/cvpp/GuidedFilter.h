@@ -0,0 +1,105 @@
+#ifndef __GUIDED_FILTER_H__
+#define __GUIDED_FILTER_H__
+
+#include "Image.h"
+#include "Sampler.h"
+#include "Blur.h"
+
+namespace cvpp
+{
+
+// Edge preserving smoothing of input along the edges of guide, He, Sun & Tang,
+// "Guided Image Filtering", 2010: in every (2*radius + 1)^2 window the output is a
+// linear function a*I + b of the guide, fitted to the input with a regularization of
+// eps on a. The guide has one channel, which guides all channels of the input, or
+// one per input channel. Borders are clamped like ClampView.
+// All channels share two box passes at a cost independent of the radius: the first
+// sums I and I*I of every guide channel and p and I*p of every input channel together,
+// reading each pixel of guide and input once, and turns their means into a and b as
+// rows leave it. The second sums a and b and writes mean(a)*I + mean(b).
+inline CPUImage<float> GuidedFilter(const CPUImage<float>& guide, const CPUImage<float>& input, unsigned int radius, float eps)
+{
+	assert(guide.getWidth() == input.getWidth() && guide.getHeight() == input.getHeight() && "The guide needs the size of the input!");
+	assert((guide.getComponents() == 1 || guide.getComponents() == input.getComponents()) && "The guide needs one channel or one per input channel!");
+
+	const int w = input.getWidth();
+	const int h = input.getHeight();
+	const int r = radius;
+	const int comps = input.getComponents();
+	const float norm = 1.0f/(2*r + 1);
+
+	CPUImage<float> out(w, h, comps);
+	CPUImage<float> coeffs(w, h, 2*comps);
+	const ClampView<float> coeffView(coeffs);
+
+	// Channel counts of input and guide as constants, the guide has one channel or Comps
+	auto filter = [&](auto C, auto G) {
+		const int Comps = C;
+		const int GuideComps = G;
+		const int terms = 2*(GuideComps + Comps);
+
+		// Terms of a pixel: I, I*I per guide channel, then p, I*p per input channel
+		detail::RunningSumRows<detail::RUNNING_BOX>(w, h, terms, radius, norm,
+			[&](int y, int x0, int x1, float* dst) {
+				const int cy = std::clamp(y, 0, h - 1);
+				for(int x = x0; x < x1; x++, dst += terms)
+				{
+					const int cx = std::clamp(x, 0, w - 1);
+					const float* I = guide.get(cx, cy);
+					const float* p = input.get(cx, cy);
+					for(int g = 0; g < GuideComps; g++)
+					{
+						dst[2*g] = I[g];
+						dst[2*g + 1] = I[g]*I[g];
+					}
+
+					for(int c = 0; c < Comps; c++)
+					{
+						dst[2*(GuideComps + c)] = p[c];
+						dst[2*(GuideComps + c) + 1] = I[GuideComps == 1 ? 0 : c]*p[c];
+					}
+				}
+			},
+			[&](int y, int x0, int x1, const float* means) {
+				float* dst = coeffs.get(x0, y);
+				for(int x = 0; x < x1 - x0; x++, means += terms, dst += 2*Comps)
+				{
+					for(int c = 0; c < Comps; c++)
+					{
+						const int gc = (GuideComps == 1 ? 0 : c);
+						const float meanI = means[2*gc];
+						const float meanP = means[2*(GuideComps + c)];
+						const float covariance = means[2*(GuideComps + c) + 1] - meanI*meanP;
+						const float variance = means[2*gc + 1] - meanI*meanI;
+						const float a = covariance/(variance + eps);
+
+						dst[2*c] = a;
+						dst[2*c + 1] = meanP - a*meanI;
+					}
+				}
+			});
+
+		detail::RunningSumRows<detail::RUNNING_BOX>(w, h, 2*Comps, radius, norm,
+			[&](int y, int x0, int x1, float* dst) { coeffView.sampleRow(y, x0, x1, dst); },
+			[&](int y, int x0, int x1, const float* means) {
+				const float* I = guide.get(x0, y);
+				float* dst = out.get(x0, y);
+				for(int x = 0; x < x1 - x0; x++, I += GuideComps, dst += Comps, means += 2*Comps)
+					for(int c = 0; c < Comps; c++)
+						dst[c] = means[2*c]*I[GuideComps == 1 ? 0 : c] + means[2*c + 1];
+			});
+	};
+
+	detail::WithComponents(comps, [&](auto C) {
+		if(guide.getComponents() == 1)
+			filter(C, std::integral_constant<int, 1>());
+		else
+			filter(C, C);
+	});
+
+	return out;
+}
+
+}
+
+#endif
@@ -3,11 +3,53 @@
 
 #include "Feature.h"
 #include "StructureTensor.h"
-
-#include <mutex>
+#include "NonMaxSuppression.h"
 
 namespace cvpp
 {
+namespace detail
+{
+// Harris measure det/trace of the structure tensor, computed as its rows come out
+inline CPUImage<float> HarrisResponse(const CPUImage<float>& gray)
+{
+	const int w = gray.getWidth();
+	CPUImage<float> out(w, gray.getHeight(), 1);
+
+	StructureTensorRows(gray, [&](int y, const float* t) {
+		float* dst = out.get(0, y);
+		for(int x = 0; x < w; x++)
+		{
+			const float a = t[3*x], b = t[3*x + 1], d = t[3*x + 2];
+			const float trace = a + d;
+			dst[x] = trace > 0.0f ? std::abs((a*d - b*b)/trace) : 0.0f;
+		}
+	});
+
+	return out;
+}
+
+// |Lxx + Lyy| of a scale space level, multiplied by norm
+inline CPUImage<float> LaplacianResponse(const CPUImage<float>& level, float norm)
+{
+	auto [Lxx, Lyy] = ConvoluteMulti(ClampView(level), LaplaceKernelX(), LaplaceKernelY());
+
+	#pragma omp parallel for
+	for(int i = 0; i < int(Lxx.getData().size()); i++)
+		Lxx[i] = norm*std::abs(Lxx[i] + Lyy[i]);
+
+	return std::move(Lxx);
+}
+}
+
+// Harris corners with the scale selection of Harris-Laplace, Mikolajczyk & Schmid,
+// "Scale & Affine Invariant Interest Point Detectors", 2004. The image is blurred into
+// a discrete scale space with scales sqrt(2)^k, k < ScaleLevels: as in SIFT every level
+// is blurred further from the one before and every second level is decimated by 2 in
+// the same pass, so each step is a Gaussian of 1 or sqrt(2) level pixels. Every level
+// gets its Laplacian normalized by the squared scale in full resolution pixels, the
+// scale where it is largest at a pixel is its Feature::scale. Corners are detected on
+// the Harris measure at scale 1 as the maxima of their patchSize window with a measure
+// of at least threshold, so only they look up their scale.
 template<typename T>
 void HarrisDetector(const CPUImage<T>& in, unsigned int patchSize, float threshold, std::vector<Feature>& features)
 {
@@ -16,144 +58,63 @@ void HarrisDetector(const CPUImage<T>& in, unsigned int patchSize, float thresho
 //		return (mtx.determinant() / mtx.trace());
 //	});
 
-	CPUImage<float> scaledHarris(in.getWidth(), in.getHeight(), 2);
+	constexpr int ScaleLevels = 8;
 
-	{
-		auto gray = MakeGrayscale(ConvertType<T, float>(in));
-		auto sampler = ClampView(gray);
-
-		auto Dx = Convolute2D(sampler, ScharrFilterH());
-		auto Dy = Convolute2D(sampler, ScharrFilterV());
-
-		// ConvertType<float, unsigned char>(Dx).save("DX.png");
-		// ConvertType<float, unsigned char>(Dy).save("DY.png");
+	auto level = MakeGrayscale(ConvertType<T, float>(in));
+	const auto harris = detail::HarrisResponse(level);
 
-		auto Sx = Dx*Dx;
-		auto Sy = Dy*Dy;
-		auto Sxy = Dx*Dy;
-
-		Sx = ConvoluteSeparable(ClampView(Sx), GaussFilter<3>(1.0f));
-		Sy = ConvoluteSeparable(ClampView(Sy), GaussFilter<3>(1.0f));
-		Sxy = ConvoluteSeparable(ClampView(Sxy), GaussFilter<3>(1.0f));
+	std::vector<CPUImage<float>> responses;
+	float scales[ScaleLevels];
+	for(int k = 0; k < ScaleLevels; k++)
+	{
+		if(k > 0 && k % 2 == 0)
+			level = ConvoluteSeparableDecimated(ClampView(level), GaussFilter<9>(float(M_SQRT2)), 2);
+		else
+			level = ConvoluteSeparable(ClampView(level), GaussFilter<7>(1.0f));
+
+		// Level pixels are 2^(k/2) pixels apart, derivatives grow by that
+		scales[k] = std::pow(float(M_SQRT2), k);
+		const float norm = scales[k]/float(1 << (k/2));
+		responses.push_back(detail::LaplacianResponse(level, norm*norm));
+	}
 
-		#pragma omp parallel for
-		for(int y = 0; y < in.getHeight(); y++)
+	// Only detected corners need their scale, from the nearest sample of every level
+	auto selectScale = [&](unsigned int x, unsigned int y) {
+		float best = -1.0f;
+		int bestLevel = 0;
+		for(int k = 0; k < ScaleLevels; k++)
 		{
-			GaussView SxView(Sx);
-			GaussView SyView(Sy);
-			GaussView SxyView(Sxy);
-
-			const size_t yoff = y*in.getWidth();
-			for(int x = 0; x < in.getWidth(); x++)
+			const CPUImage<float>& response = responses[k];
+			const int shift = k/2;
+			const int half = (1 << shift)/2;
+			const float v = *response.get(std::min<int>((x + half) >> shift, response.getWidth() - 1),
+										  std::min<int>((y + half) >> shift, response.getHeight() - 1));
+			if(v > best)
 			{
-				const size_t off = (yoff+x)*2;
-
-				float sigma = 1;
-				float harris = 0;
-				float h0 = 0;
-
-				float u = float(x)/in.getWidth();
-				float v = float(y)/in.getHeight();
-
-				// First iteration
-				{
-					const float a = SxView.sample(u, v).x();
-					const float b = SxyView.sample(u, v).x();
-					const float c = b;
-					const float d = SyView.sample(u, v).x();
-
-					h0 = harris = std::abs((a*d - b*c)/(a+d));
-				}
-
-				for(int i = 0; i < 1000; i++)
-				{
-					SxView.setSigma(sigma);
-					SyView.setSigma(sigma);
-					SxyView.setSigma(sigma);
-
-					const float a = SxView.sample(u, v).x();
-					const float b = SxyView.sample(u, v).x();
-					const float c = b;
-					const float d = SyView.sample(u, v).x();
-
-					const float nharris = std::abs((a*d - b*c)/(a+d));
-					const float dh = nharris - harris;
-
-					if(dh <= 0) break;
-					
-					harris = nharris;
-					sigma += 0.1;
-				}
-
-#if 0
-				if(sigma != 1)
-				{
-					std::cout << "Harris: " << harris << std::endl;
-					std::cout << "SIGMA: " << sigma << std::endl;
-				}
-#endif
-
-				scaledHarris[off] = h0;
-				scaledHarris[off + 1] = sigma;
-
-				//output[off] <<	ColorToFloat(Sx[off]), ColorToFloat(Sxy[off]),
-				//				ColorToFloat(Sxy[off]), ColorToFloat(Sy[off]);
+				best = v;
+				bestLevel = k;
 			}
 		}
-	}
-	
-	std::mutex mtx;
-
-	auto determinant = cvpp::NonLinearConv2D<-1>(cvpp::ClampView(scaledHarris), patchSize,
-	[](int x, int y, auto v, auto& result) {
-		auto vabs = std::abs(v[0]);
-		auto sigma = v[1];
-		if(vabs >= result[0])
-		{
-			result[0] = vabs;
-			result[1] = x;
-			result[2] = y;
-			result[3] = sigma;
-		}
-	},
-	[&features, threshold, &mtx](auto x, auto y, auto v) {
-		if(v[0] >= threshold)
-		{
-			std::lock_guard<std::mutex> g(mtx);
-			features.emplace_back(Feature{static_cast<unsigned int>(x + v[1]), static_cast<unsigned int>(y + v[2]), v[3]});
-		}
-	});
+
+		return scales[bestLevel];
+	};
+
+	const size_t first = features.size();
+	NonMaxSuppression(harris, patchSize/2, threshold, features);
+
+	#pragma omp parallel for
+	for(int i = int(first); i < int(features.size()); i++)
+		features[i].scale = selectScale(features[i].x, features[i].y);
 }
 
+// Blobs on the determinant of the Hessian at sigma 1, maxima of their patchSize window
+// with a determinant of at least threshold
 template<typename T>
 void HessianDetector(const CPUImage<T>& in, unsigned int patchSize, float threshold, std::vector<Feature>& features)
 {
-	auto gray = MakeGrayscale(ConvertType<T, float>(in));
-	auto sampler = ClampView(gray);
+	const auto determinant = HessianResponse(MakeGrayscale(ConvertType<T, float>(in)), 1.0f);
 
-	auto tensor = cvpp::HessianTensor(in);
-	auto determinant = tensor.transform([](const Eigen::Matrix2f& mtx) -> float {
-		return mtx.determinant();
-	});
-	
-	std::mutex mtx;
-	determinant = cvpp::NonLinearConv2D<-1>(cvpp::ClampView(determinant), patchSize,
-	[](int x, int y, auto v, auto& result) {
-		auto vabs = std::abs(v[0]);
-		if(vabs >= result[0])
-		{
-			result[0] = vabs;
-			result[1] = x;
-			result[2] = y;
-		}
-	},
-	[&features, threshold, &mtx](auto x, auto y, auto v) {
-		if(v[0] >= threshold)
-		{
-			std::lock_guard<std::mutex> g(mtx);
-			features.emplace_back(Feature{static_cast<unsigned int>(x + v[1]), static_cast<unsigned int>(y + v[2]), 0.0f});
-		}
-	});
+	NonMaxSuppression(determinant, patchSize/2, threshold, features);
 }
 
 }
@@ -4,9 +4,16 @@
 #include <vector>
 #include <string>
 #include <limits>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <utility>
 
 #include <type_traits>
 
+#include "Dispatch.h"
+
 namespace cvpp
 {
 
@@ -43,6 +50,16 @@ T FloatToColor(float v)
 	return T(std::clamp(v, 0.0f, 1.0f) * std::numeric_limits<T>::max());
 }
 
+// Like FloatToColor but rounds to the nearest value
+template<typename T>
+T RoundToColor(float v)
+{
+	if constexpr(std::is_floating_point_v<T>)
+		return v;
+
+	return T(std::lround(std::clamp(v, 0.0f, 1.0f) * std::numeric_limits<T>::max()));
+}
+
 template<typename From, typename To>
 To ColorToColor(const From& v)
 {
@@ -52,6 +69,53 @@ To ColorToColor(const From& v)
 	return FloatToColor<To>(ColorToFloat<From>(v));
 }
 
+namespace detail
+{
+// Runs fn(offset, count) on blocks of a flat array in parallel.
+template<typename Fn>
+void ForEachBlock(size_t count, Fn&& fn)
+{
+	constexpr size_t BlockSize = 1 << 14;
+	const long blocks = (count + BlockSize - 1)/BlockSize;
+
+#pragma omp parallel for
+	for(long b = 0; b < blocks; b++)
+	{
+		const size_t offset = b*BlockSize;
+		fn(offset, std::min(BlockSize, count - offset));
+	}
+}
+
+// Same as ColorToFloat/FloatToColor on a whole span
+template<typename T>
+void ToFloat(const T* in, float* out, size_t count)
+{
+	if constexpr(std::is_same_v<T, float>)
+		std::copy(in, in + count, out);
+	else if constexpr(std::is_same_v<T, uint8_t>)
+		Dispatch::getKernels().u8ToFloat(in, out, count);
+	else if constexpr(std::is_same_v<T, uint16_t>)
+		Dispatch::getKernels().u16ToFloat(in, out, count);
+	else
+		for(size_t i = 0; i < count; i++)
+			out[i] = ColorToFloat<T>(in[i]);
+}
+
+template<typename T>
+void FromFloat(const float* in, T* out, size_t count)
+{
+	if constexpr(std::is_same_v<T, float>)
+		std::copy(in, in + count, out);
+	else if constexpr(std::is_same_v<T, uint8_t>)
+		Dispatch::getKernels().floatToU8(in, out, count);
+	else if constexpr(std::is_same_v<T, uint16_t>)
+		Dispatch::getKernels().floatToU16(in, out, count);
+	else
+		for(size_t i = 0; i < count; i++)
+			out[i] = FloatToColor<T>(in[i]);
+}
+}
+
 enum IMAGE_TYPE
 {
 	UCHAR,
@@ -171,6 +235,14 @@ public:
 		assert(getWidth() == b.getWidth() && getHeight() == b.getHeight() && getComponents() == b.getComponents());
 		CPUImage<T> out(getWidth(), getHeight(), getComponents());
 
+		if constexpr(std::is_same_v<T, float> && std::is_same_v<S, float>)
+		{
+			detail::ForEachBlock(m_data.size(), [&](size_t off, size_t count) {
+				Dispatch::getKernels().add(&m_data[off], &b[off], &out[off], count);
+			});
+			return out;
+		}
+
 		#pragma omp parallel for
 		for(int i = 0; i < m_data.size(); i++)
 		{
@@ -187,6 +259,14 @@ public:
 		assert(getWidth() == b.getWidth() && getHeight() == b.getHeight() && getComponents() == b.getComponents());
 		CPUImage<S> out(getWidth(), getHeight(), getComponents());
 
+		if constexpr(std::is_same_v<T, float> && std::is_same_v<S, float>)
+		{
+			detail::ForEachBlock(m_data.size(), [&](size_t off, size_t count) {
+				Dispatch::getKernels().sub(&m_data[off], &b[off], &out[off], count);
+			});
+			return out;
+		}
+
 		#pragma omp parallel for
 		for(int i = 0; i < m_data.size(); i++)
 		{
@@ -202,6 +282,14 @@ public:
 		assert(getWidth() == b.getWidth() && getHeight() == b.getHeight() && getComponents() == b.getComponents());
 		CPUImage<S> out(getWidth(), getHeight(), getComponents());
 
+		if constexpr(std::is_same_v<T, float> && std::is_same_v<S, float>)
+		{
+			detail::ForEachBlock(m_data.size(), [&](size_t off, size_t count) {
+				Dispatch::getKernels().mul(&m_data[off], &b[off], &out[off], count);
+			});
+			return out;
+		}
+
 		#pragma omp parallel for
 		for(int i = 0; i < m_data.size(); i++)
 		{
@@ -218,6 +306,14 @@ public:
 		assert(getWidth() == b.getWidth() && getHeight() == b.getHeight() && getComponents() == b.getComponents());
 		CPUImage<S> out(getWidth(), getHeight(), getComponents());
 
+		if constexpr(std::is_same_v<T, float> && std::is_same_v<S, float>)
+		{
+			detail::ForEachBlock(m_data.size(), [&](size_t off, size_t count) {
+				Dispatch::getKernels().div(&m_data[off], &b[off], &out[off], count);
+			});
+			return out;
+		}
+
 		#pragma omp parallel for
 		for(int i = 0; i < m_data.size(); i++)
 		{
@@ -274,6 +370,21 @@ CPUImage<Out> ConvertType(const CPUImage<In>& img)
 	const auto& inData = img.getData();
 	auto& outData = out.getData();
 
+	if constexpr(std::is_same_v<Out, float>)
+	{
+		detail::ForEachBlock(inData.size(), [&](size_t off, size_t count) {
+			detail::ToFloat<In>(&inData[off], &outData[off], count);
+		});
+		return out;
+	}
+	else if constexpr(std::is_same_v<In, float>)
+	{
+		detail::ForEachBlock(inData.size(), [&](size_t off, size_t count) {
+			detail::FromFloat<Out>(&inData[off], &outData[off], count);
+		});
+		return out;
+	}
+
 #pragma omp parallel for
 	for(unsigned int idxIn = 0; idxIn < inData.size(); idxIn += comps)
 	{
@@ -300,6 +411,14 @@ CPUImage<T> MakeGrayscale(const CPUImage<T>& img, const float weights[4])
 	const auto& inData = img.getData();
 	auto& outData = out.getData();
 
+	if constexpr(std::is_same_v<T, float>)
+	{
+		detail::ForEachBlock(outData.size(), [&](size_t off, size_t count) {
+			Dispatch::getKernels().grayscale(&inData[off*comps], &outData[off], count, comps, weights);
+		});
+		return out;
+	}
+
 #pragma omp parallel for
 	for(unsigned int idx = 0; idx < outData.size(); idx++)
 	{
@@ -373,6 +492,14 @@ template<typename T>
 CPUImage<T> Sum(const CPUImage<T>& r1, const CPUImage<T>& r2)
 {
 	CPUImage<T> out(r1.getWidth(), r1.getHeight(), r1.getComponents());
+	if constexpr(std::is_same_v<T, float>)
+	{
+		detail::ForEachBlock(out.getData().size(), [&](size_t off, size_t count) {
+			Dispatch::getKernels().add(&r1[off], &r2[off], &out[off], count);
+		});
+		return out;
+	}
+
 	for(unsigned int idx = 0; idx < out.getData().size(); idx++)
 	{
 		out.getData()[idx] = r1.getData()[idx] + r2.getData()[idx];
@@ -380,5 +507,47 @@ CPUImage<T> Sum(const CPUImage<T>& r1, const CPUImage<T>& r2)
 	return out;
 }
 
+// Mean over all pixels and components in ColorToFloat units
+template<typename T>
+double Mean(const CPUImage<T>& img)
+{
+	const auto& data = img.getData();
+	if(data.empty())
+		return 0.0;
+
+	double sum = 0.0;
+	if constexpr(std::is_same_v<T, float>)
+	{
+		sum = Dispatch::getKernels().sum(data.data(), data.size());
+	}
+	else
+	{
+		for(const auto& v : data)
+			sum += ColorToFloat<T>(v);
+	}
+
+	return sum / data.size();
+}
+
+template<typename T>
+std::pair<float, float> MinMax(const CPUImage<T>& img)
+{
+	const auto& data = img.getData();
+	if constexpr(std::is_same_v<T, float>)
+	{
+		float min, max;
+		Dispatch::getKernels().minMax(data.data(), data.size(), min, max);
+		return {min, max};
+	}
+	else
+	{
+		auto range = std::minmax_element(data.begin(), data.end());
+		if(range.first == data.end())
+			return {0.0f, 0.0f};
+
+		return {ColorToFloat<T>(*range.first), ColorToFloat<T>(*range.second)};
+	}
+}
+
 }
 #endif
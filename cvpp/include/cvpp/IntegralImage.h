@@ -0,0 +1,192 @@
+#ifndef __INTEGRAL_IMAGE_H__
+#define __INTEGRAL_IMAGE_H__
+
+#include "Image.h"
+
+#include <eigen3/Eigen/Dense>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+namespace cvpp
+{
+
+// Summed-area table of an image, or of its squared values if Squared is set.
+// Sums are kept in the units of T (not normalized like ColorToFloat). Integer
+// images accumulate in 32 bits if the sum over the whole image fits, otherwise
+// in 64 bits; floating point images use double. Since every rectangle sum fits
+// into the accumulator, wrapping intermediate values still give exact results.
+template<typename T, bool Squared = false>
+class IntegralImage
+{
+public:
+	IntegralImage(const CPUImage<T>& img):
+		m_width(img.getWidth()),
+		m_height(img.getHeight()),
+		m_components(img.getComponents())
+	{
+		if constexpr(std::is_floating_point_v<T>)
+			build(img, m_real);
+		else
+		{
+			const uint64_t max = std::numeric_limits<T>::max();
+			const uint64_t total = (Squared ? max*max : max)*uint64_t(m_width)*m_height;
+			m_wide = total > std::numeric_limits<uint32_t>::max();
+
+			if(m_wide)
+				build(img, m_sums64);
+			else
+				build(img, m_sums32);
+		}
+	}
+
+	unsigned int getWidth() const { return m_width; }
+	unsigned int getHeight() const { return m_height; }
+	unsigned int getComponents() const { return m_components; }
+
+	// True if 64 bit accumulators are used
+	bool isWide() const { return m_wide; }
+
+	// Sum of channel c over x0 <= x < x1, y0 <= y < y1
+	double rectSum(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, unsigned int c) const
+	{
+		assert(x0 <= x1 && x1 <= m_width && y0 <= y1 && y1 <= m_height && c < m_components);
+
+		if constexpr(std::is_floating_point_v<T>)
+			return rect(m_real, x0, y0, x1, y1, c);
+		else if(m_wide)
+			return rect(m_sums64, x0, y0, x1, y1, c);
+		else
+			return rect(m_sums32, x0, y0, x1, y1, c);
+	}
+
+	Eigen::Vector4d rectSum(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1) const
+	{
+		Eigen::Vector4d sum(0, 0, 0, 0);
+		for(unsigned int c = 0; c < m_components; c++)
+			sum[c] = rectSum(x0, y0, x1, y1, c);
+
+		return sum;
+	}
+
+private:
+	size_t index(unsigned int x, unsigned int y) const { return (size_t(y)*(m_width + 1) + x)*m_components; }
+
+	template<typename Acc>
+	Acc rect(const std::vector<Acc>& sums, unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, unsigned int c) const
+	{
+		return sums[index(x1, y1) + c] - sums[index(x0, y1) + c] - sums[index(x1, y0) + c] + sums[index(x0, y0) + c];
+	}
+
+	// Row prefix sums in parallel over rows, then column prefix sums in
+	// parallel over strips of columns which add whole row segments.
+	template<typename Acc>
+	void build(const CPUImage<T>& img, std::vector<Acc>& sums)
+	{
+		constexpr size_t StripWidth = 1024;
+		const size_t rowSize = size_t(m_width + 1)*m_components;
+		sums.assign(rowSize*(m_height + 1), Acc(0));
+
+		#pragma omp parallel for
+		for(int y = 0; y < m_height; y++)
+		{
+			const T* src = img.get(0, y);
+			Acc* dst = &sums[index(1, y + 1)];
+			Acc acc[4] = {};
+
+			for(unsigned int x = 0; x < m_width; x++)
+			{
+				for(unsigned int c = 0; c < m_components; c++)
+				{
+					const Acc v = src[x*m_components + c];
+					acc[c] += (Squared ? v*v : v);
+					dst[x*m_components + c] = acc[c];
+				}
+			}
+		}
+
+		const int strips = (rowSize + StripWidth - 1)/StripWidth;
+
+		#pragma omp parallel for
+		for(int s = 0; s < strips; s++)
+		{
+			const size_t begin = s*StripWidth;
+			const size_t end = std::min(rowSize, begin + StripWidth);
+			for(unsigned int y = 2; y <= m_height; y++)
+			{
+				Acc* row = &sums[y*rowSize];
+				const Acc* prev = row - rowSize;
+				for(size_t i = begin; i < end; i++)
+					row[i] += prev[i];
+			}
+		}
+	}
+
+	unsigned int m_width = 0;
+	unsigned int m_height = 0;
+	unsigned int m_components = 0;
+	bool m_wide = false;
+
+	std::vector<uint32_t> m_sums32;
+	std::vector<uint64_t> m_sums64;
+	std::vector<double> m_real;
+};
+
+struct LocalStatisticsResult
+{
+	CPUImage<float> mean;
+	CPUImage<float> variance;
+};
+
+// Mean and variance over a (2*radius + 1)^2 window around every pixel from a
+// summed-area table of the values and one of their squares, at a constant cost
+// per pixel. The window is cut at the image border. Results are normalized like
+// ColorToFloat.
+template<typename T>
+LocalStatisticsResult LocalStatistics(const IntegralImage<T>& sums, const IntegralImage<T, true>& squares, unsigned int radius)
+{
+	const int w = sums.getWidth();
+	const int h = sums.getHeight();
+	const int comps = sums.getComponents();
+	const double scale = std::is_floating_point_v<T> ? 1.0 : 1.0/double(std::numeric_limits<T>::max());
+
+	LocalStatisticsResult result{CPUImage<float>(w, h, comps), CPUImage<float>(w, h, comps)};
+
+	#pragma omp parallel for
+	for(int y = 0; y < h; y++)
+	{
+		const unsigned int y0 = std::max(0, y - int(radius));
+		const unsigned int y1 = std::min(h, y + int(radius) + 1);
+		float* mean = result.mean.get(0, y);
+		float* variance = result.variance.get(0, y);
+
+		for(int x = 0; x < w; x++)
+		{
+			const unsigned int x0 = std::max(0, x - int(radius));
+			const unsigned int x1 = std::min(w, x + int(radius) + 1);
+			const double n = double(x1 - x0)*(y1 - y0);
+
+			for(int c = 0; c < comps; c++)
+			{
+				const double m = sums.rectSum(x0, y0, x1, y1, c)/n;
+				const double sq = squares.rectSum(x0, y0, x1, y1, c)/n;
+
+				mean[x*comps + c] = m*scale;
+				variance[x*comps + c] = std::max(0.0, sq - m*m)*scale*scale;
+			}
+		}
+	}
+
+	return result;
+}
+
+template<typename T>
+LocalStatisticsResult LocalStatistics(const CPUImage<T>& img, unsigned int radius)
+{
+	return LocalStatistics(IntegralImage<T>(img), IntegralImage<T, true>(img), radius);
+}
+
+}
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef __KERNEL_DECOMPOSITION_H__
+#define __KERNEL_DECOMPOSITION_H__
+
+#include <eigen3/Eigen/Dense>
+#include <vector>
+
+namespace cvpp
+{
+
+// Low rank form of a square kernel: kernel = sum_i vertical[i] * horizontal[i]^T
+struct KernelDecomposition
+{
+	std::vector<Eigen::VectorXf> vertical;
+	std::vector<Eigen::VectorXf> horizontal;
+
+	unsigned int getRank() const { return vertical.size(); }
+
+	// True if running the separable passes is cheaper than the full stencil
+	bool isSeparable() const { return !vertical.empty(); }
+};
+
+// Decomposes the kernel with an SVD, singular values below tolerance times the
+// largest one are dropped. The result is cached per kernel and tolerance, the
+// decomposition is left empty if it would not save any work.
+KernelDecomposition DecomposeKernel(const Eigen::MatrixXf& kernel, float tolerance = 1e-5f);
+
+}
+
+#endif
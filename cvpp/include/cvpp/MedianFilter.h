@@ -0,0 +1,359 @@
+#ifndef __MEDIAN_FILTER_H__
+#define __MEDIAN_FILTER_H__
+
+#include "Image.h"
+#include "Sampler.h"
+#include "Convolution.h"
+
+#include <array>
+#include <utility>
+
+namespace cvpp
+{
+
+namespace detail
+{
+// Median of N values as compare-exchange steps: Batcher's odd-even merge sort for
+// N elements, without the steps that only move values which do not end up in the
+// middle. Steps which only need one of their outputs become a single min or max.
+template<int N>
+struct MedianNetwork
+{
+	struct Step
+	{
+		int a = 0, b = 0;
+		bool keepMin = false, keepMax = false;
+	};
+
+	static constexpr int MaxSteps = N*N;
+
+	struct Plan
+	{
+		int count = 0;
+		std::array<Step, MaxSteps> steps{};
+	};
+
+	static constexpr Plan make()
+	{
+		Plan all;
+		for(int p = 1; p < N; p <<= 1)
+			for(int k = p; k >= 1; k >>= 1)
+				for(int j = k % p; j + k < N; j += 2*k)
+					for(int i = 0; i < k && i + j + k < N; i++)
+						if((i + j)/(2*p) == (i + j + k)/(2*p))
+							all.steps[all.count++] = Step{i + j, i + j + k, true, true};
+
+		std::array<bool, N> needed{};
+		needed[N/2] = true;
+
+		Plan pruned;
+		for(int s = all.count - 1; s >= 0; s--)
+		{
+			Step step = all.steps[s];
+			step.keepMin = needed[step.a];
+			step.keepMax = needed[step.b];
+			if(!step.keepMin && !step.keepMax)
+				continue;
+
+			needed[step.a] = needed[step.b] = true;
+			pruned.steps[pruned.count++] = step;
+		}
+
+		for(int s = 0; s < pruned.count/2; s++)
+			std::swap(pruned.steps[s], pruned.steps[pruned.count - 1 - s]);
+
+		return pruned;
+	}
+
+	static constexpr Plan Value = make();
+};
+
+// Runs the network on Chunk independent sets of values at once, v[k][j] is value k of set j
+template<int N, int Chunk, typename T, size_t... S>
+inline void ApplyMedianNetwork(T (*v)[Chunk], std::index_sequence<S...>)
+{
+	constexpr auto& plan = MedianNetwork<N>::Value;
+
+	([&] {
+		constexpr auto step = plan.steps[S];
+		T* a = v[step.a];
+		T* b = v[step.b];
+		for(int j = 0; j < Chunk; j++)
+		{
+			const T lo = std::min(a[j], b[j]);
+			const T hi = std::max(a[j], b[j]);
+			if constexpr(step.keepMin)
+				a[j] = lo;
+			if constexpr(step.keepMax)
+				b[j] = hi;
+		}
+	}(), ...);
+}
+
+// Small windows: the window values of a chunk of row elements are gathered and
+// passed through the median network, vectorized across the chunk.
+template<int Radius, typename T>
+void MedianNetworkFilter(const SamplerView<T>& sampler, CPUImage<T>& out)
+{
+	constexpr int Size = 2*Radius + 1;
+	constexpr int N = Size*Size;
+	constexpr int Chunk = 64;
+
+	const int w = out.getWidth();
+	const int comps = out.getComponents();
+	const size_t rowSize = size_t(w)*comps;
+	using Steps = std::make_index_sequence<MedianNetwork<N>::Value.count>;
+
+	ForEachRowBlock(out.getHeight(), [&](int y0, int y1) {
+		T values[N][Chunk];
+		SlidingRows<T>(y0, y1, Size, rowSize + 2*Radius*comps,
+			[&](int y, T* dst) { sampler.sampleRowTexels(y, -Radius, w + Radius, dst); },
+			[&](int y, const T* const* rows) {
+				T* dst = out.get(0, y);
+				for(size_t i0 = 0; i0 < rowSize; i0 += Chunk)
+				{
+					const int count = std::min<size_t>(Chunk, rowSize - i0);
+					for(int k = 0; k < N; k++)
+					{
+						const T* src = rows[k/Size] + i0 + size_t(k % Size)*comps;
+						for(int j = 0; j < count; j++)
+							values[k][j] = src[j];
+					}
+
+					ApplyMedianNetwork<N, Chunk>(values, Steps());
+
+					for(int j = 0; j < count; j++)
+						dst[i0 + j] = values[N/2][j];
+				}
+			});
+	});
+}
+
+// Perreault & Hebert, "Median Filtering in Constant Time", 2007: every column keeps a
+// histogram of its 2*radius + 1 values in the window rows, which moves down by adding
+// one value and removing one. Along a row the window histogram adds the column that
+// enters and subtracts the one that leaves. Only the coarse level of 16 bins is
+// updated on every step, a 16 bin segment of the fine level is brought up to date
+// when the median falls into it, which is mostly the same segment as before. Count
+// holds up to (2*radius + 1)^2.
+template<typename Count>
+void MedianHistogramFilter(const SamplerView<uint8_t>& sampler, int radius, CPUImage<uint8_t>& out)
+{
+	constexpr int Bins = 256;
+	constexpr int Segment = 16;
+	constexpr int Segments = Bins/Segment;
+
+	const int size = 2*radius + 1;
+	const int w = out.getWidth();
+	const int comps = out.getComponents();
+	const size_t paddedSize = size_t(w + 2*radius)*comps;
+	const int rank = size*size/2;
+
+	ForEachRowBlock(out.getHeight(), std::max(RowBlockSize, 4*size), [&](int y0, int y1) {
+		std::vector<Count> columns(paddedSize*Bins), coarseColumns(paddedSize*Segments);
+		std::vector<Count> window(comps*Bins), coarseWindow(comps*Segments);
+		std::vector<int> updated(comps*Segments);
+
+		auto update = [&](const uint8_t* row, int delta) {
+			for(size_t i = 0; i < paddedSize; i++)
+			{
+				columns[i*Bins + row[i]] += delta;
+				coarseColumns[i*Segments + row[i]/Segment] += delta;
+			}
+		};
+
+		auto fine = [&](int x, int c, int segment) { return &columns[(size_t(x)*comps + c)*Bins + segment*Segment]; };
+		auto coarse = [&](int x, int c) { return &coarseColumns[(size_t(x)*comps + c)*Segments]; };
+
+		// Value of the given rank at x from the segment of the window histogram it falls into,
+		// which is updated from where it was last valid or rebuilt. Sums go through a local
+		// copy which cannot alias the column histograms.
+		auto findMedian = [&](int x, int c, int segment, int below) {
+			Count* hist = &window[c*Bins + segment*Segment];
+			int& last = updated[c*Segments + segment];
+			Count acc[Segment];
+
+			if(x - last > size/2)
+			{
+				std::fill_n(acc, Segment, 0);
+				for(int k = 0; k < size; k++)
+				{
+					const Count* col = fine(x + k, c, segment);
+					for(int i = 0; i < Segment; i++)
+						acc[i] += col[i];
+				}
+			}
+			else
+			{
+				std::copy_n(hist, Segment, acc);
+				for(int j = last + 1; j <= x; j++)
+				{
+					const Count* enter = fine(j + size - 1, c, segment);
+					const Count* leave = fine(j - 1, c, segment);
+					for(int i = 0; i < Segment; i++)
+						acc[i] += enter[i] - leave[i];
+				}
+			}
+
+			std::copy_n(acc, Segment, hist);
+			last = x;
+
+			int bin = 0;
+			while(below + int(acc[bin]) <= rank)
+				below += acc[bin++];
+
+			return segment*Segment + bin;
+		};
+
+		// rows[radius + 1 + k] is row y + k
+		SlidingRows<uint8_t>(y0, y1, size + 2, paddedSize,
+			[&](int y, uint8_t* dst) { sampler.sampleRowTexels(y, -radius, w + radius, dst); },
+			[&](int y, const uint8_t* const* rows) {
+				if(y == y0)
+				{
+					std::fill(columns.begin(), columns.end(), 0);
+					std::fill(coarseColumns.begin(), coarseColumns.end(), 0);
+					for(int k = -radius; k <= radius; k++)
+						update(rows[radius + 1 + k], 1);
+				}
+				else
+				{
+					update(rows[0], -1);
+					update(rows[2*radius + 1], 1);
+				}
+
+				std::fill(coarseWindow.begin(), coarseWindow.end(), 0);
+				std::fill(updated.begin(), updated.end(), -size);
+				for(int c = 0; c < comps; c++)
+				{
+					Count* hist = &coarseWindow[c*Segments];
+					for(int k = 0; k < size; k++)
+					{
+						const Count* col = coarse(k, c);
+						for(int i = 0; i < Segments; i++)
+							hist[i] += col[i];
+					}
+				}
+
+				uint8_t* dst = out.get(0, y);
+				for(int x = 0; x < w; x++)
+				{
+					for(int c = 0; c < comps; c++)
+					{
+						Count* coarseHist = &coarseWindow[c*Segments];
+
+						int below = 0, segment = 0;
+						while(below + int(coarseHist[segment]) <= rank)
+							below += coarseHist[segment++];
+
+						dst[x*comps + c] = findMedian(x, c, segment, below);
+
+						if(x + 1 < w)
+						{
+							const Count* enter = coarse(x + size, c);
+							const Count* leave = coarse(x, c);
+							for(int i = 0; i < Segments; i++)
+								coarseHist[i] += enter[i] - leave[i];
+						}
+					}
+				}
+			});
+	});
+}
+
+// Huang's sliding histogram for 16 bit values, which are too many for a histogram
+// per column: the window histogram of a row adds and removes one column of values
+// per step. Two levels of 256 bins keep the median search short.
+template<typename Count>
+void MedianHistogramFilter(const SamplerView<uint16_t>& sampler, int radius, CPUImage<uint16_t>& out)
+{
+	constexpr int Bins = 65536;
+	constexpr int CoarseBins = 256;
+
+	const int size = 2*radius + 1;
+	const int w = out.getWidth();
+	const int comps = out.getComponents();
+	const int rank = size*size/2;
+
+	ForEachRowBlock(out.getHeight(), [&](int y0, int y1) {
+		std::vector<Count> hist(size_t(comps)*Bins), coarseHist(comps*CoarseBins);
+
+		auto update = [&](const uint16_t* const* rows, int x, int delta) {
+			for(int k = 0; k < size; k++)
+			{
+				const uint16_t* px = rows[k] + size_t(x)*comps;
+				for(int c = 0; c < comps; c++)
+				{
+					hist[size_t(c)*Bins + px[c]] += delta;
+					coarseHist[c*CoarseBins + px[c]/CoarseBins] += delta;
+				}
+			}
+		};
+
+		SlidingRows<uint16_t>(y0, y1, size, size_t(w + 2*radius)*comps,
+			[&](int y, uint16_t* dst) { sampler.sampleRowTexels(y, -radius, w + radius, dst); },
+			[&](int y, const uint16_t* const* rows) {
+				for(int x = 0; x < size; x++)
+					update(rows, x, 1);
+
+				uint16_t* dst = out.get(0, y);
+				for(int x = 0; x < w; x++)
+				{
+					for(int c = 0; c < comps; c++)
+					{
+						const Count* fine = &hist[size_t(c)*Bins];
+						const Count* coarse = &coarseHist[c*CoarseBins];
+
+						int below = 0, bin = 0;
+						while(below + int(coarse[bin]) <= rank)
+							below += coarse[bin++];
+
+						bin *= CoarseBins;
+						while(below + int(fine[bin]) <= rank)
+							below += fine[bin++];
+
+						dst[x*comps + c] = bin;
+					}
+
+					update(rows, x, -1);
+					if(x + 1 < w)
+						update(rows, x + size, 1);
+				}
+
+				// Only the columns of the last window are left
+				for(int x = w; x < w + size - 1; x++)
+					update(rows, x, -1);
+			});
+	});
+}
+}
+
+// Median over a (2*radius + 1)^2 window for 8 and 16 bit images. Windows of 3x3 and
+// 5x5 use a sorting network, larger 8 bit windows run in constant time per pixel
+// (Perreault-Hebert) and larger 16 bit windows in time linear in the radius (Huang).
+// The histograms count in 16 bit up to a radius of 127 and in 32 bit beyond.
+template<typename T>
+CPUImage<T> MedianFilter(const SamplerView<T>& sampler, unsigned int radius)
+{
+	static_assert(std::is_same_v<T, uint8_t> || std::is_same_v<T, uint16_t>, "The median filter needs 8 or 16 bit images!");
+
+	const CPUImage<T>& in = *sampler.getImage();
+	CPUImage<T> out(in.getWidth(), in.getHeight(), in.getComponents());
+
+	if(radius == 0)
+		out.getData() = in.getData();
+	else if(radius == 1)
+		detail::MedianNetworkFilter<1>(sampler, out);
+	else if(radius == 2)
+		detail::MedianNetworkFilter<2>(sampler, out);
+	else if(radius <= 127)
+		detail::MedianHistogramFilter<uint16_t>(sampler, radius, out);
+	else
+		detail::MedianHistogramFilter<uint32_t>(sampler, radius, out);
+
+	return out;
+}
+
+}
+
+#endif
@@ -0,0 +1,207 @@
+#ifndef __MORPHOLOGY_H__
+#define __MORPHOLOGY_H__
+
+#include "Image.h"
+#include "Sampler.h"
+#include "Convolution.h"
+
+namespace cvpp
+{
+
+enum MORPHOLOGY_TYPE
+{
+	ERODE,
+	DILATE
+};
+
+namespace detail
+{
+template<MORPHOLOGY_TYPE Op, typename T>
+inline T Extremum(T a, T b)
+{
+	if constexpr(Op == ERODE)
+		return std::min(a, b);
+	else
+		return std::max(a, b);
+}
+
+// van Herk, "A fast algorithm for local minimum and maximum filters on rectangular
+// and octagonal kernels", 1992 and Gil & Werman, 1993: the input is cut into blocks
+// of size vectors, prefix holds the running extremum from the start of a block and
+// suffix the one to its end. A window covers the end of one block and the start of
+// the next, so out[i] = extremum(suffix[i], prefix[i + size - 1]) for three
+// comparisons per element regardless of the size.
+// in holds count + size - 1 vectors of width elements which are stride apart, each
+// step handles a whole vector.
+template<MORPHOLOGY_TYPE Op, typename T>
+void ExtremumPass(const T* in, T* out, T* prefix, T* suffix, int count, size_t stride, size_t width, int size)
+{
+	const int n = count + size - 1;
+
+	for(int i = 0; i < n; i++)
+	{
+		const T* f = in + i*stride;
+		T* g = prefix + i*stride;
+		if(i % size == 0)
+			std::copy_n(f, width, g);
+		else
+			for(size_t j = 0; j < width; j++)
+				g[j] = Extremum<Op>(g[j - stride], f[j]);
+	}
+
+	for(int i = n - 1; i >= 0; i--)
+	{
+		const T* f = in + i*stride;
+		T* h = suffix + i*stride;
+		if(i % size == size - 1 || i == n - 1)
+			std::copy_n(f, width, h);
+		else
+			for(size_t j = 0; j < width; j++)
+				h[j] = Extremum<Op>(h[j + stride], f[j]);
+	}
+
+	for(int i = 0; i < count; i++)
+	{
+		const T* h = suffix + i*stride;
+		const T* g = prefix + (i + size - 1)*stride;
+		T* dst = out + i*stride;
+		for(size_t j = 0; j < width; j++)
+			dst[j] = Extremum<Op>(h[j], g[j]);
+	}
+}
+
+// Vertical pass on the padded rows of a block, then the horizontal pass on groups of
+// rows interleaved so that every step along x is a vector over all rows of a group.
+template<MORPHOLOGY_TYPE Op, typename T>
+CPUImage<T> Morphology(const SamplerView<T>& sampler, unsigned int width, unsigned int height)
+{
+	assert(width % 2 != 0 && height % 2 != 0 && "A structuring element needs an odd size!");
+
+	constexpr int Lanes = 32;
+
+	const CPUImage<T>& in = *sampler.getImage();
+	CPUImage<T> out(in.getWidth(), in.getHeight(), in.getComponents());
+	const int rx = width/2;
+	const int ry = height/2;
+	const int w = in.getWidth();
+	const int comps = in.getComponents();
+	const int paddedW = w + 2*rx;
+	const size_t rowSize = size_t(paddedW)*comps;
+	const size_t laneSize = size_t(Lanes)*comps;
+
+	ForEachRowBlock(in.getHeight(), std::max(RowBlockSize, 4*int(height)), [&](int y0, int y1) {
+		const int rows = y1 - y0;
+		const int paddedRows = rows + 2*ry;
+
+		// The running extrema serve both passes
+		const size_t scratch = std::max(paddedRows*rowSize, paddedW*laneSize);
+		std::vector<T> padded(paddedRows*rowSize), vertical(rows*rowSize);
+		std::vector<T> prefix(scratch), suffix(scratch);
+		for(int k = 0; k < paddedRows; k++)
+			sampler.sampleRowTexels(y0 - ry + k, -rx, w + rx, &padded[k*rowSize]);
+
+		ExtremumPass<Op>(padded.data(), vertical.data(), prefix.data(), suffix.data(), rows, rowSize, rowSize, height);
+
+		std::vector<T> interleaved(paddedW*laneSize), result(w*laneSize);
+		for(int l0 = 0; l0 < rows; l0 += Lanes)
+		{
+			const int count = std::min(Lanes, rows - l0);
+			for(int l = 0; l < count; l++)
+			{
+				const T* src = &vertical[(l0 + l)*rowSize];
+				for(int x = 0; x < paddedW; x++)
+					for(int c = 0; c < comps; c++)
+						interleaved[x*laneSize + l*comps + c] = src[x*comps + c];
+			}
+
+			ExtremumPass<Op>(interleaved.data(), result.data(), prefix.data(), suffix.data(), w, laneSize, count*comps, width);
+
+			for(int l = 0; l < count; l++)
+			{
+				T* dst = out.get(0, y0 + l0 + l);
+				for(int x = 0; x < w; x++)
+					for(int c = 0; c < comps; c++)
+						dst[x*comps + c] = result[x*laneSize + l*comps + c];
+			}
+		}
+	});
+
+	return out;
+}
+
+// a - b, clamped at zero for unsigned types
+template<typename T>
+CPUImage<T> Difference(const CPUImage<T>& a, const CPUImage<T>& b)
+{
+	assert(a.getData().size() == b.getData().size());
+	CPUImage<T> out(a.getWidth(), a.getHeight(), a.getComponents());
+
+	#pragma omp parallel for
+	for(size_t i = 0; i < a.getData().size(); i++)
+	{
+		if constexpr(std::is_floating_point_v<T>)
+			out[i] = a[i] - b[i];
+		else
+			out[i] = a[i] > b[i] ? a[i] - b[i] : T(0);
+	}
+
+	return out;
+}
+}
+
+// Minimum and maximum over a width x height rectangle at a constant cost per pixel,
+// borders follow the sampler.
+template<typename T>
+CPUImage<T> Erode(const SamplerView<T>& sampler, unsigned int width, unsigned int height)
+{
+	return detail::Morphology<ERODE>(sampler, width, height);
+}
+
+template<typename T>
+CPUImage<T> Erode(const SamplerView<T>& sampler, unsigned int size)
+{
+	return Erode(sampler, size, size);
+}
+
+template<typename T>
+CPUImage<T> Dilate(const SamplerView<T>& sampler, unsigned int width, unsigned int height)
+{
+	return detail::Morphology<DILATE>(sampler, width, height);
+}
+
+template<typename T>
+CPUImage<T> Dilate(const SamplerView<T>& sampler, unsigned int size)
+{
+	return Dilate(sampler, size, size);
+}
+
+// Compositions, the second pass clamps at the border.
+template<typename T>
+CPUImage<T> Open(const SamplerView<T>& sampler, unsigned int width, unsigned int height)
+{
+	return Dilate(ClampView(Erode(sampler, width, height)), width, height);
+}
+
+template<typename T>
+CPUImage<T> Close(const SamplerView<T>& sampler, unsigned int width, unsigned int height)
+{
+	return Erode(ClampView(Dilate(sampler, width, height)), width, height);
+}
+
+// Bright details smaller than the structuring element: the image minus its opening.
+template<typename T>
+CPUImage<T> TopHat(const SamplerView<T>& sampler, unsigned int width, unsigned int height)
+{
+	return detail::Difference(*sampler.getImage(), Open(sampler, width, height));
+}
+
+// Morphological gradient: dilation minus erosion.
+template<typename T>
+CPUImage<T> MorphologicalGradient(const SamplerView<T>& sampler, unsigned int width, unsigned int height)
+{
+	return detail::Difference(Dilate(sampler, width, height), Erode(sampler, width, height));
+}
+
+}
+
+#endif
@@ -0,0 +1,135 @@
+#ifndef __NON_LOCAL_MEANS_H__
+#define __NON_LOCAL_MEANS_H__
+
+#include "Image.h"
+#include "Sampler.h"
+#include "Convolution.h"
+
+namespace cvpp
+{
+
+// Non-local means denoising, Buades, Coll & Morel, "A non-local algorithm for image
+// denoising", 2005: every pixel becomes the weighted mean of the pixels within
+// searchRadius, weighted by exp(-d^2/h^2) where d^2 is the mean squared difference of
+// the (2*patchRadius + 1)^2 patches around them, in ColorToFloat units over all channels.
+// As in Darbon et al., "Fast nonlocal filtering applied to electron cryomicroscopy",
+// 2008, the search runs over offsets instead of pixels: for one offset the squared
+// differences of the image and its shifted copy are box summed, which gives the patch
+// distance of every pixel at a constant cost. Tiles run in parallel, each with its own
+// sampled input and accumulators, so nothing is shared between threads.
+template<typename T>
+CPUImage<T> NonLocalMeans(const SamplerView<T>& sampler, float h, unsigned int searchRadius = 10, unsigned int patchRadius = 3)
+{
+	assert(h > 0.0f && "The filter strength needs to be positive!");
+
+	constexpr int TileWidth = 128;
+	constexpr int TileHeight = 64;
+
+	// Weights stay above e^-MaxExponent, which keeps the weighted values from becoming
+	// denormal and slowing everything down while adding nothing visible to the mean
+	constexpr float MaxExponent = 30.0f;
+
+	const CPUImage<T>& in = *sampler.getImage();
+	CPUImage<T> out(in.getWidth(), in.getHeight(), in.getComponents());
+	const int w = in.getWidth();
+	const int height = in.getHeight();
+	const int comps = in.getComponents();
+	const int S = searchRadius;
+	const int P = patchRadius;
+	const int R = S + P;
+	const int patchSize = 2*P + 1;
+	const auto& kernels = Dispatch::getKernels();
+
+	// Squared differences are averaged over the channels, the row sums of the patch
+	// come out scaled into the exponent
+	const float ones[] = {1.0f, 1.0f, 1.0f, 1.0f};
+	const std::vector<float> rowKernel(patchSize, -1.0f/(h*h*patchSize*patchSize));
+
+	const int tilesX = (w + TileWidth - 1)/TileWidth;
+	const int tilesY = (height + TileHeight - 1)/TileHeight;
+
+	#pragma omp parallel for schedule(dynamic)
+	for(int tile = 0; tile < tilesX*tilesY; tile++)
+	{
+		const int x0 = (tile % tilesX)*TileWidth;
+		const int y0 = (tile / tilesX)*TileHeight;
+		const int tw = std::min(TileWidth, w - x0);
+		const int th = std::min(TileHeight, height - y0);
+
+		// The tile with a border of R pixels, src(yy, xx) is pixel (x0 - R + xx, y0 - R + yy)
+		const int pw = tw + 2*R;
+		const size_t srcRow = size_t(pw)*comps;
+		std::vector<float> src((th + 2*R)*srcRow);
+		for(int yy = 0; yy < th + 2*R; yy++)
+			sampler.sampleRow(y0 - R + yy, x0 - R, x0 + tw + R, &src[yy*srcRow]);
+
+		auto pixel = [&](int yy, int xx) { return &src[yy*srcRow + size_t(xx)*comps]; };
+
+		// Squared differences over the tile with a border of P pixels
+		const int dw = tw + 2*P;
+		std::vector<float> diff((th + 2*P)*dw), squares(size_t(dw)*comps);
+		std::vector<float> columns(dw), weights(size_t(tw)*comps);
+		std::vector<float> sum(size_t(tw)*th*comps), weightSum(size_t(tw)*th);
+
+		for(int dy = -S; dy <= S; dy++)
+		{
+			for(int dx = -S; dx <= S; dx++)
+			{
+				for(int i = 0; i < th + 2*P; i++)
+				{
+					const float* a = pixel(i + S, S);
+					const float* b = pixel(i + S + dy, S + dx);
+					float* d = (comps == 1 ? &diff[i*dw] : squares.data());
+					kernels.sub(a, b, d, squares.size());
+					kernels.mul(d, d, d, squares.size());
+					if(comps > 1)
+						kernels.grayscale(d, &diff[i*dw], dw, comps, ones);
+				}
+
+				// Column sums of the patch rows slide down, row sums of those are a convolution
+				std::fill(columns.begin(), columns.end(), 0.0f);
+				for(int i = 0; i < patchSize - 1; i++)
+					kernels.add(columns.data(), &diff[i*dw], columns.data(), dw);
+
+				for(int y = 0; y < th; y++)
+				{
+					kernels.add(columns.data(), &diff[(y + patchSize - 1)*dw], columns.data(), dw);
+
+					kernels.convolveRow(columns.data(), weights.data(), tw, rowKernel.data(), patchSize, 1);
+					kernels.sub(columns.data(), &diff[y*dw], columns.data(), dw);
+
+					for(int x = 0; x < tw; x++)
+						weights[x] = std::max(weights[x], -MaxExponent);
+
+					kernels.exp(weights.data(), weights.data(), tw);
+
+					kernels.add(&weightSum[size_t(y)*tw], weights.data(), &weightSum[size_t(y)*tw], tw);
+					if(comps > 1)
+						for(int x = tw - 1; x >= 0; x--)
+							std::fill_n(&weights[x*comps], comps, weights[x]);
+
+					const float* shifted = pixel(y + R + dy, R + dx);
+					float* acc = &sum[size_t(y)*tw*comps];
+					for(size_t i = 0; i < size_t(tw)*comps; i++)
+						acc[i] += weights[i]*shifted[i];
+				}
+			}
+		}
+
+		for(int y = 0; y < th; y++)
+		{
+			float* acc = &sum[size_t(y)*tw*comps];
+			for(int x = 0; x < tw; x++)
+				for(int c = 0; c < comps; c++)
+					acc[x*comps + c] /= weightSum[size_t(y)*tw + x];
+
+			detail::FromFloat(acc, out.get(x0, y0 + y), size_t(tw)*comps);
+		}
+	}
+
+	return out;
+}
+
+}
+
+#endif
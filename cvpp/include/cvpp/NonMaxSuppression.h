@@ -0,0 +1,68 @@
+#ifndef __NON_MAX_SUPPRESSION_H__
+#define __NON_MAX_SUPPRESSION_H__
+
+#include "Image.h"
+#include "Feature.h"
+#include "Morphology.h"
+
+namespace cvpp
+{
+
+// Appends every pixel of at least threshold which is the maximum of the (2*radius + 1)^2
+// window around it, borders clamped, with its value as the response. Equal maxima are
+// broken in row major order: a pixel only passes if it is strictly greater than the
+// pixels of its window before it, so a plateau leaves a single pixel per window. The
+// window maxima come from the constant time dilation, so the test is one comparison
+// per pixel whatever the radius, and only maxima look back at their window. Blocks of rows
+// collect their features in their own buffer and the buffers are appended in block
+// order, so features come out in row major order without any locking.
+inline void NonMaxSuppression(const CPUImage<float>& response, unsigned int radius, float threshold, std::vector<Feature>& features)
+{
+	assert(response.getComponents() == 1 && "Non maximum suppression needs a single channel!");
+
+	const int w = response.getWidth();
+	const int h = response.getHeight();
+	const int r = radius;
+	const auto maxima = Dilate(ClampView(response), 2*radius + 1);
+
+	// Row y up to x, then the rows above, which finds a neighbour on a plateau at once
+	auto firstOfWindow = [&](int x, int y, float v) {
+		for(int sy = y; sy >= std::max(0, y - r); sy--)
+		{
+			const float* row = response.get(0, sy);
+			const int x1 = (sy == y ? x : std::min(w, x + r + 1));
+			for(int sx = std::max(0, x - r); sx < x1; sx++)
+				if(row[sx] == v)
+					return false;
+		}
+
+		return true;
+	};
+
+	const int blocks = (h + detail::RowBlockSize - 1)/detail::RowBlockSize;
+	std::vector<std::vector<Feature>> found(blocks);
+
+	detail::ForEachRowBlock(h, [&](int y0, int y1) {
+		auto& local = found[y0/detail::RowBlockSize];
+		for(int y = y0; y < y1; y++)
+		{
+			const float* v = response.get(0, y);
+			const float* m = maxima.get(0, y);
+			for(int x = 0; x < w; x++)
+				if(v[x] >= threshold && v[x] == m[x] && firstOfWindow(x, y, v[x]))
+					local.push_back(Feature{unsigned(x), unsigned(y), 0.0f, v[x]});
+		}
+	});
+
+	size_t count = 0;
+	for(const auto& local : found)
+		count += local.size();
+
+	features.reserve(features.size() + count);
+	for(const auto& local : found)
+		features.insert(features.end(), local.begin(), local.end());
+}
+
+}
+
+#endif
@@ -0,0 +1,179 @@
+#ifndef __PYRAMID_H__
+#define __PYRAMID_H__
+
+#include "Image.h"
+#include "Sampler.h"
+#include "Convolution.h"
+#include "CommonFilters.h"
+
+#include <mutex>
+
+namespace cvpp
+{
+
+namespace detail
+{
+// Upsampling by 2 with the transposed [1 4 6 4 1]/16 kernel of the pyramid: even outputs
+// take (1, 6, 1)/8 of the coarse pixels around them, odd ones the mean of their two
+// neighbours. Coarse rows are expanded horizontally once per block of output rows,
+// store(y, row) receives every expanded row.
+template<typename T, typename Store>
+void PyramidExpandRows(const SamplerView<T>& coarse, unsigned int width, unsigned int height, Store&& store)
+{
+	const int cw = coarse.getImage()->getWidth();
+	const int comps = coarse.getImage()->getComponents();
+	const size_t rowSize = size_t(width)*comps;
+
+	// p holds the coarse row with one pixel of border, even and odd outputs are written
+	// as two strided passes
+	auto expand = [&](const float* p, float* dst) {
+		const size_t even = (width + 1)/2, odd = width/2;
+		for(size_t m = 0; m < even; m++)
+			for(int c = 0; c < comps; c++)
+			{
+				const float* px = p + (m + 1)*comps + c;
+				dst[2*m*comps + c] = (px[-comps] + 6.0f*px[0] + px[comps])*0.125f;
+			}
+
+		for(size_t m = 0; m < odd; m++)
+			for(int c = 0; c < comps; c++)
+			{
+				const float* px = p + (m + 1)*comps + c;
+				dst[(2*m + 1)*comps + c] = (px[0] + px[comps])*0.5f;
+			}
+	};
+
+	ForEachRowBlock(height, [&](int y0, int y1) {
+		const int first = y0/2 - 1;
+		const int last = (y1 - 1)/2 + 1;
+		std::vector<float> padded(size_t(cw + 2)*comps), rows((last - first + 1)*rowSize), result(rowSize);
+
+		for(int m = first; m <= last; m++)
+		{
+			coarse.sampleRow(m, -1, cw + 1, padded.data());
+			expand(padded.data(), &rows[(m - first)*rowSize]);
+		}
+
+		for(int y = y0; y < y1; y++)
+		{
+			const float* center = &rows[(y/2 - first)*rowSize];
+			const float* below = center + rowSize;
+			if(y % 2 == 0)
+			{
+				const float* above = center - rowSize;
+				for(size_t i = 0; i < rowSize; i++)
+					result[i] = (above[i] + 6.0f*center[i] + below[i])*0.125f;
+			}
+			else
+				for(size_t i = 0; i < rowSize; i++)
+					result[i] = (center[i] + below[i])*0.5f;
+
+			store(y, result.data());
+		}
+	});
+}
+
+template<typename T>
+CPUImage<float> PyramidExpand(const SamplerView<T>& coarse, unsigned int width, unsigned int height)
+{
+	CPUImage<float> out(width, height, coarse.getImage()->getComponents());
+	PyramidExpandRows(coarse, width, height, [&](int y, const float* row) {
+		std::copy_n(row, size_t(width)*out.getComponents(), out.get(0, y));
+	});
+
+	return out;
+}
+}
+
+// Gaussian and Laplacian pyramid after Burt & Adelson, "The Laplacian Pyramid as a
+// Compact Image Code", 1983. Level 0 is the image, every further level is the one
+// before blurred with [1 4 6 4 1]/16 and decimated by 2 (rounded up) in one pass,
+// borders are clamped. Levels are built when they are first asked for, each one
+// with the row parallel operators, so consumers can share one pyramid and only pay
+// for the levels they use. Every level is built once behind its own flag, so threads
+// asking for different levels don't wait for each other.
+template<typename T>
+class ImagePyramid
+{
+public:
+	ImagePyramid(const CPUImage<T>& image, unsigned int levels):
+		m_gaussian(levels),
+		m_laplacian(levels),
+		m_gaussianBuilt(levels),
+		m_laplacianBuilt(levels)
+	{
+		assert(levels > 0 && "A pyramid needs at least one level!");
+		m_gaussian[0] = image;
+	}
+
+	unsigned int getLevelCount() const { return m_gaussian.size(); }
+
+	// The level of the Gaussian pyramid, coarser by 2^level
+	const CPUImage<T>& getLevel(unsigned int level)
+	{
+		assert(level < getLevelCount());
+
+		if(level > 0)
+			std::call_once(m_gaussianBuilt[level], [&] {
+				m_gaussian[level] = ConvoluteSeparableDecimated(ClampView(getLevel(level - 1)), BinomialFilter<5>(), 2);
+			});
+
+		return m_gaussian[level];
+	}
+
+	// The difference between a Gaussian level and the next one expanded back, the
+	// coarsest level keeps the Gaussian level. In ColorToFloat units, so the image is
+	// the sum of all levels each expanded to the size of the one before.
+	const CPUImage<float>& getLaplacian(unsigned int level)
+	{
+		assert(level < getLevelCount());
+
+		std::call_once(m_laplacianBuilt[level], [&] {
+			const CPUImage<T>& fine = getLevel(level);
+			CPUImage<float>& result = m_laplacian[level];
+
+			if(level + 1 < getLevelCount())
+			{
+				const size_t rowSize = size_t(fine.getWidth())*fine.getComponents();
+				result = CPUImage<float>(fine.getWidth(), fine.getHeight(), fine.getComponents());
+				detail::PyramidExpandRows(ClampView(getLevel(level + 1)), fine.getWidth(), fine.getHeight(), [&](int y, const float* expanded) {
+					float* dst = result.get(0, y);
+					detail::ToFloat(fine.get(0, y), dst, rowSize);
+					Dispatch::getKernels().sub(dst, expanded, dst, rowSize);
+				});
+			}
+			else
+				result = ConvertType<T, float>(fine);
+		});
+
+		return m_laplacian[level];
+	}
+
+	// Builds all Gaussian levels at once and optionally all Laplacian levels. Gaussian
+	// levels depend on each other and are built in turn. The Laplacian levels are
+	// independent: the finest has enough rows to keep all threads busy, the coarser
+	// ones have few row blocks each and are built side by side.
+	void build(bool laplacian = false)
+	{
+		getLevel(getLevelCount() - 1);
+		if(!laplacian)
+			return;
+
+		getLaplacian(0);
+
+		const int levels = getLevelCount();
+#pragma omp parallel for schedule(dynamic)
+		for(int level = 1; level < levels; level++)
+			getLaplacian(level);
+	}
+
+private:
+	std::vector<CPUImage<T>> m_gaussian;
+	std::vector<CPUImage<float>> m_laplacian;
+	std::vector<std::once_flag> m_gaussianBuilt;
+	std::vector<std::once_flag> m_laplacianBuilt;
+};
+
+}
+
+#endif
@@ -0,0 +1,216 @@
+#ifndef __REMAP_H__
+#define __REMAP_H__
+
+#include "Image.h"
+#include "Sampler.h"
+#include "Dispatch.h"
+
+#include <eigen3/Eigen/Dense>
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+namespace cvpp
+{
+
+// Precomputed per-pixel coordinate transform for bilinear remapping.
+// Every output pixel stores the integer top-left source texel and an index into
+// a shared table of fixed-point interpolation weights, so applying the table costs
+// four loads and four multiply-adds per pixel and channel.
+class RemapTable
+{
+public:
+	static constexpr int FractionBits = 5;
+	static constexpr int FractionSteps = 1 << FractionBits;
+	static constexpr int WeightBits = 14;
+	static constexpr int WeightOne = 1 << WeightBits;
+
+	struct Weights
+	{
+		int16_t fixed[4];
+		float real[4];
+	};
+
+	RemapTable() = default;
+	RemapTable(unsigned int w, unsigned int h):
+		m_width(w),
+		m_height(h)
+	{
+		m_coords.resize(size_t(w)*h*2);
+		m_fractions.resize(size_t(w)*h);
+	}
+
+	// Builds the table from fn(x, y), which returns the source position of the
+	// output pixel (x, y) in pixel coordinates.
+	template<typename Fn>
+	RemapTable(unsigned int w, unsigned int h, Fn&& fn):
+		RemapTable(w, h)
+	{
+		#pragma omp parallel for
+		for(int y = 0; y < int(h); y++)
+			for(int x = 0; x < int(w); x++)
+				set(x, y, fn(x, y));
+	}
+
+	// OpenCV style camera model, dist = (k1, k2, p1, p2, k3).
+	static RemapTable Undistortion(unsigned int w, unsigned int h, const Eigen::Matrix3f& K, const Eigen::Matrix<float, 5, 1>& dist);
+	static RemapTable Rectification(unsigned int w, unsigned int h, const Eigen::Matrix3f& K, const Eigen::Matrix<float, 5, 1>& dist,
+									const Eigen::Matrix3f& R, const Eigen::Matrix3f& P);
+
+	void set(unsigned int x, unsigned int y, const Eigen::Vector2f& src);
+
+	unsigned int getWidth() const { return m_width; }
+	unsigned int getHeight() const { return m_height; }
+
+	const int16_t* getCoords(unsigned int x, unsigned int y) const { return &m_coords[(x + size_t(y)*m_width)*2]; }
+	const uint16_t* getFractions(unsigned int x, unsigned int y) const { return &m_fractions[x + size_t(y)*m_width]; }
+
+	static const std::array<Weights, FractionSteps*FractionSteps>& getWeights();
+	// The fixed point weights packed for Dispatch's bilinearU8: w0 | w1 << 16, then w2 | w3 << 16
+	static const std::array<int32_t, 2*FractionSteps*FractionSteps>& getWeightPairs();
+
+private:
+	unsigned int m_width = 0, m_height = 0;
+
+	std::vector<int16_t> m_coords;
+	std::vector<uint16_t> m_fractions;
+};
+
+template<typename T>
+CPUImage<T> Remap(const SamplerView<T>& sampler, const RemapTable& table)
+{
+	constexpr int TileSize = 32;
+
+	const CPUImage<T>& in = *sampler.getImage();
+	const int comps = in.getComponents();
+	const int inW = in.getWidth();
+	const int inH = in.getHeight();
+	const size_t inStride = size_t(inW)*comps;
+
+	const int w = table.getWidth();
+	const int h = table.getHeight();
+	const int tilesX = (w + TileSize - 1)/TileSize;
+	const int tilesY = (h + TileSize - 1)/TileSize;
+
+	const auto& weights = RemapTable::getWeights();
+	CPUImage<T> out(w, h, comps);
+	assert(comps <= 4 && "Remap supports up to 4 channels!");
+
+	auto pixel = [&](const int16_t* coords, uint16_t fraction, T* outPtr) {
+		const int sx = coords[0];
+		const int sy = coords[1];
+		const auto& wt = weights[fraction];
+
+		if(sx >= 0 && sy >= 0 && sx + 1 < inW && sy + 1 < inH)
+		{
+			const T* p0 = in.get(sx, sy);
+			const T* p1 = p0 + inStride;
+
+			for(int c = 0; c < comps; c++)
+			{
+				if constexpr(std::is_integral_v<T> && sizeof(T) <= 2)
+				{
+					const int32_t sum = wt.fixed[0]*p0[c] + wt.fixed[1]*p0[c + comps]
+									+ wt.fixed[2]*p1[c] + wt.fixed[3]*p1[c + comps];
+					outPtr[c] = T((sum + (1 << (RemapTable::WeightBits - 1))) >> RemapTable::WeightBits);
+				}
+				else
+				{
+					const float sum = wt.real[0]*ColorToFloat(p0[c]) + wt.real[1]*ColorToFloat(p0[c + comps])
+									+ wt.real[2]*ColorToFloat(p1[c]) + wt.real[3]*ColorToFloat(p1[c + comps]);
+					outPtr[c] = FloatToColor<T>(sum);
+				}
+			}
+		}
+		else
+		{
+			// Let the sampler decide what lies outside of the image.
+			auto tap = [&](int px, int py) -> Eigen::Vector4f {
+				if(px >= 0 && py >= 0 && px < inW && py < inH)
+					return sampler.texel(px, py);
+				return sampler.sample(px, py);
+			};
+
+			const Eigen::Vector4f sum = wt.real[0]*tap(sx, sy) + wt.real[1]*tap(sx + 1, sy)
+									+ wt.real[2]*tap(sx, sy + 1) + wt.real[3]*tap(sx + 1, sy + 1);
+
+			for(int c = 0; c < comps; c++)
+			{
+				if constexpr(std::is_integral_v<T>)
+					outPtr[c] = T(std::lround(std::clamp(sum[c], 0.0f, 1.0f)*std::numeric_limits<T>::max()));
+				else
+					outPtr[c] = FloatToColor<T>(sum[c]);
+			}
+		}
+	};
+
+	// Tiles keep the source footprint of a block of output pixels in cache even for
+	// rotated or strongly distorted maps.
+#pragma omp parallel for collapse(2)
+	for(int ty = 0; ty < tilesY; ty++)
+	{
+		for(int tx = 0; tx < tilesX; tx++)
+		{
+			const int x0 = tx*TileSize;
+			const int x1 = std::min(x0 + TileSize, w);
+			const int y1 = std::min((ty + 1)*TileSize, h);
+
+			for(int y = ty*TileSize; y < y1; y++)
+			{
+				const int16_t* coords = table.getCoords(x0, y);
+				const uint16_t* fractions = table.getFractions(x0, y);
+				T* outPtr = out.get(x0, y);
+
+				if constexpr(std::is_same_v<T, uint8_t>)
+				{
+					// Every channel of a pixel whose taps lie inside the image, with room for the
+					// word reads of the gathers, goes through the dispatched kernel in one call per
+					// tile row. The other pixels get offset 0 and are overwritten afterwards.
+					std::array<int32_t, TileSize*4> offsets;
+					std::array<uint16_t, TileSize*4> elementFractions;
+					std::array<int, TileSize> slow;
+					int slowCount = 0;
+					bool anyFast = false;
+
+					for(int i = 0; i < x1 - x0; i++)
+					{
+						const int sx = coords[2*i];
+						const int sy = coords[2*i + 1];
+						const size_t base = size_t(sy)*inStride + size_t(sx)*comps;
+						const bool fast = sx >= 0 && sy >= 0 && sx + 1 < inW && sy + 1 < inH
+										&& base + 2*comps + inStride + 2 < in.getData().size();
+
+						for(int c = 0; c < comps; c++)
+						{
+							offsets[i*comps + c] = fast ? int32_t(base + c) : 0;
+							elementFractions[i*comps + c] = fast ? fractions[i] : 0;
+						}
+
+						anyFast |= fast;
+						if(!fast)
+							slow[slowCount++] = i;
+					}
+
+					if(anyFast)
+						Dispatch::getKernels().bilinearU8(in.getData().data(), offsets.data(), elementFractions.data(),
+														  RemapTable::getWeightPairs().data(), outPtr, size_t(x1 - x0)*comps,
+														  comps, inStride, RemapTable::WeightBits);
+
+					for(int k = 0; k < slowCount; k++)
+						pixel(coords + 2*slow[k], fractions[slow[k]], outPtr + slow[k]*comps);
+				}
+				else
+				{
+					for(int x = x0; x < x1; x++, coords += 2, fractions++, outPtr += comps)
+						pixel(coords, *fractions, outPtr);
+				}
+			}
+		}
+	}
+
+	return out;
+}
+
+}
+
+#endif
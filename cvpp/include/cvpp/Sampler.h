@@ -3,6 +3,7 @@
 
 #include "Image.h"
 #include <eigen3/Eigen/StdVector>
+#include <cmath>
 
 namespace cvpp
 {
@@ -53,10 +54,64 @@ public:
 		return px;
 	}
 
+	// Writes the samples x0 <= x < x1 of row y to dst, interleaved like the image.
+	// Texels inside the image are converted directly, everything else goes through sample().
+	virtual void sampleRow(int y, int x0, int x1, float* dst) const
+	{
+		const int w = m_image->getWidth();
+		const int comps = m_image->getComponents();
+		const bool inside = (y >= 0 && y < m_image->getHeight());
+
+		const int begin = inside ? std::clamp(0, x0, x1) : x1;
+		const int end = inside ? std::clamp(w, begin, x1) : x1;
+
+		auto border = [&](int from, int to) {
+			for(int x = from; x < to; x++)
+			{
+				const Eigen::Vector4f px = sample(x, y);
+				float* out = dst + size_t(x - x0)*comps;
+				for(int c = 0; c < comps; c++)
+					out[c] = px[c];
+			}
+		};
+
+		border(x0, begin);
+		if(end > begin)
+			detail::ToFloat<T>(m_image->get(begin, y), dst + size_t(begin - x0)*comps, size_t(end - begin)*comps);
+		border(end, x1);
+	}
+
+	// Same as sampleRow but keeps the pixel type, samples which do not come
+	// straight from a texel are rounded to the nearest value of T.
+	virtual void sampleRowTexels(int y, int x0, int x1, T* dst) const
+	{
+		const int w = m_image->getWidth();
+		const int comps = m_image->getComponents();
+		const bool inside = (y >= 0 && y < m_image->getHeight());
+
+		const int begin = inside ? std::clamp(0, x0, x1) : x1;
+		const int end = inside ? std::clamp(w, begin, x1) : x1;
+
+		auto border = [&](int from, int to) {
+			for(int x = from; x < to; x++)
+			{
+				const Eigen::Vector4f px = sample(x, y);
+				T* out = dst + size_t(x - x0)*comps;
+				for(int c = 0; c < comps; c++)
+					out[c] = RoundToColor<T>(px[c]);
+			}
+		};
+
+		border(x0, begin);
+		if(end > begin)
+			std::copy_n(m_image->get(begin, y), size_t(end - begin)*comps, dst + size_t(begin - x0)*comps);
+		border(end, x1);
+	}
+
 	Eigen::Vector2i getXY(float u, float v) const
 	{
-		const float x = std::trunc(u*(m_image->getWidth() - 1));
-		const float y = std::trunc(v*(m_image->getHeight() - 1));
+		const float x = std::round(u*(m_image->getWidth() - 1));
+		const float y = std::round(v*(m_image->getHeight() - 1));
 		return Eigen::Vector2i(x, y);
 	}
 
@@ -83,6 +138,49 @@ public:
 
 		return SamplerView<T>::sample(u, v);
 	}
+
+	// Rows are clamped and the border repeats the converted edge texels, so wide
+	// borders cost a copy per pixel instead of a sample
+	void sampleRow(int y, int x0, int x1, float* dst) const override
+	{
+		clampedRow(y, x0, x1, dst, [](const T* in, float* out, size_t count) { detail::ToFloat<T>(in, out, count); });
+	}
+
+	void sampleRowTexels(int y, int x0, int x1, T* dst) const override
+	{
+		clampedRow(y, x0, x1, dst, [](const T* in, T* out, size_t count) { std::copy_n(in, count, out); });
+	}
+
+private:
+	template<typename Out, typename Convert>
+	void clampedRow(int y, int x0, int x1, Out* dst, Convert&& convert) const
+	{
+		const CPUImage<T>& img = *SamplerView<T>::m_image;
+		const int w = img.getWidth();
+		const int comps = img.getComponents();
+		const T* row = img.get(0, std::clamp(y, 0, int(img.getHeight()) - 1));
+
+		const int begin = std::clamp(0, x0, x1);
+		const int end = std::clamp(w, begin, x1);
+		auto at = [&](int x) { return dst + size_t(x - x0)*comps; };
+
+		if(end > begin)
+			convert(row + size_t(begin)*comps, at(begin), size_t(end - begin)*comps);
+
+		if(begin > x0)
+		{
+			convert(row, at(x0), comps);
+			for(int x = x0 + 1; x < begin; x++)
+				std::copy_n(at(x0), comps, at(x));
+		}
+
+		if(x1 > end)
+		{
+			convert(row + size_t(w - 1)*comps, at(end), comps);
+			for(int x = end + 1; x < x1; x++)
+				std::copy_n(at(end), comps, at(x));
+		}
+	}
 };
 
 
@@ -122,6 +220,28 @@ public:
 		return sum;
 	}
 
+	void sampleRow(int y, int x0, int x1, float* dst) const override
+	{
+		const int comps = SamplerView<T>::m_image->getComponents();
+		for(int x = x0; x < x1; x++)
+		{
+			const Eigen::Vector4f px = SamplerView<T>::sample(x, y);
+			for(int c = 0; c < comps; c++)
+				dst[size_t(x - x0)*comps + c] = px[c];
+		}
+	}
+
+	void sampleRowTexels(int y, int x0, int x1, T* dst) const override
+	{
+		const int comps = SamplerView<T>::m_image->getComponents();
+		for(int x = x0; x < x1; x++)
+		{
+			const Eigen::Vector4f px = SamplerView<T>::sample(x, y);
+			for(int c = 0; c < comps; c++)
+				dst[size_t(x - x0)*comps + c] = RoundToColor<T>(px[c]);
+		}
+	}
+
 	void setSigma(float s) { m_sigma = s; }
 
 private:
@@ -5,75 +5,309 @@
 #include "CommonFilters.h"
 #include "Convolution.h"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+
 namespace cvpp
 {
 
-template<typename T>
-CPUImage<Eigen::Matrix2f> StructureTensor(const CPUImage<T>& in)
+namespace detail
+{
+// Structure tensor of a grayscale image in one pass over blocks of rows: every image
+// row is filtered once with the horizontal halves [3 10 3] and [1 0 -1] of the separable
+// Scharr kernels into a ring of three, each tensor row combines the ring vertically into
+// the derivatives, their products and the horizontal Gaussian of sigma 1, and the
+// vertical Gaussian combines three such rows kept in a second ring. Borders are clamped
+// on the image and on the products. store(y, row) gets every row as packed (xx, xy, yy)
+// triples.
+template<typename Store>
+void StructureTensorRows(const CPUImage<float>& gray, Store&& store)
 {
-	auto gray = MakeGrayscale(ConvertType<T, float>(in));
-	auto sampler = ClampView(gray);
+	const int w = gray.getWidth();
+	const int h = gray.getHeight();
+	const size_t rowSize = size_t(w)*3;
+	const auto gauss = GaussFilter<3>(1.0f);
+	const ClampView<float> sampler(gray);
+
+	ForEachRowBlock(h, [&](int y0, int y1) {
+		std::vector<float> line(w + 2), halves(3*2*size_t(w)), products((w + 2)*3), result(rowSize);
+		std::array<int, 3> stored;
+		stored.fill(std::numeric_limits<int>::min());
+
+		// Smoothed and differentiated image row m, which is filtered when it enters the ring
+		auto halvesOf = [&](int m) {
+			const int slot = mod(m, 3);
+			float* smooth = &halves[slot*2*size_t(w)];
+			float* diff = smooth + w;
+			if(stored[slot] != m)
+			{
+				sampler.sampleRow(m, -1, w + 1, line.data());
+				for(int x = 0; x < w; x++)
+				{
+					smooth[x] = 3.0f*(line[x] + line[x + 2]) + 10.0f*line[x + 1];
+					diff[x] = line[x] - line[x + 2];
+				}
 
-	auto Dx = Convolute2D(sampler, ScharrFilterH());
-	auto Dy = Convolute2D(sampler, ScharrFilterV());
+				stored[slot] = m;
+			}
 
-	// ConvertType<float, unsigned char>(Dx).save("DX.png");
-	// ConvertType<float, unsigned char>(Dy).save("DY.png");
+			return smooth;
+		};
 
-	auto Sx = Dx*Dx;
-	auto Sy = Dy*Dy;
-	auto Sxy = Dx*Dy;
+		auto fetch = [&](int row, float* dst) {
+			row = std::clamp(row, 0, h - 1);
+			const float* above = halvesOf(row - 1);
+			const float* center = halvesOf(row);
+			const float* below = halvesOf(row + 1);
 
-	Sx = ConvoluteSeparable(ClampView(Sx), GaussFilter<3>(1.0f));
-	Sy = ConvoluteSeparable(ClampView(Sy), GaussFilter<3>(1.0f));
-	Sxy = ConvoluteSeparable(ClampView(Sxy), GaussFilter<3>(1.0f));
+			float* p = &products[3];
+			for(int x = 0; x < w; x++)
+			{
+				const float dx = 3.0f*(above[w + x] + below[w + x]) + 10.0f*center[w + x];
+				const float dy = above[x] - below[x];
+				p[3*x] = dx*dx;
+				p[3*x + 1] = dx*dy;
+				p[3*x + 2] = dy*dy;
+			}
 
-	CPUImage<Eigen::Matrix2f> output(in.getWidth(), in.getHeight(), 1);
-	#pragma omp parallel for
-	for(int y = 0; y < in.getHeight(); y++)
+			std::copy_n(p, 3, &products[0]);
+			std::copy_n(p + rowSize - 3, 3, p + rowSize);
+
+			for(size_t i = 0; i < rowSize; i++)
+				dst[i] = gauss[0]*products[i] + gauss[1]*products[i + 3] + gauss[2]*products[i + 6];
+		};
+
+		SlidingRows(y0, y1, 3, rowSize, fetch, [&](int y, const float* const* rows) {
+			for(size_t i = 0; i < rowSize; i++)
+				result[i] = gauss[0]*rows[0][i] + gauss[1]*rows[1][i] + gauss[2]*rows[2][i];
+
+			store(y, result.data());
+		});
+	});
+}
+}
+
+// Image of symmetric 2x2 tensors which stores the three distinct entries (xx, xy, yy)
+// of every pixel as a packed 3 channel float image. Pixels read as Eigen::Matrix2f.
+class SymmetricTensorImage
+{
+public:
+	SymmetricTensorImage() = default;
+	SymmetricTensorImage(unsigned int w, unsigned int h):
+		m_data(w, h, 3) {}
+
+	unsigned int getWidth() const { return m_data.getWidth(); }
+	unsigned int getHeight() const { return m_data.getHeight(); }
+
+	CPUImage<float>& getData() { return m_data; }
+	const CPUImage<float>& getData() const { return m_data; }
+
+	Eigen::Matrix2f operator[](size_t idx) const
 	{
-		const size_t yoff = y*in.getWidth();
-		for(int x = 0; x < in.getWidth(); x++)
-		{
-			const size_t off = yoff+x;
-			output[off] <<	ColorToFloat(Sx[off]), ColorToFloat(Sxy[off]),
-							ColorToFloat(Sxy[off]), ColorToFloat(Sy[off]);
-		}
+		const float* t = &m_data[idx*3];
+		Eigen::Matrix2f mtx;
+		mtx <<	t[0], t[1],
+				t[1], t[2];
+
+		return mtx;
+	}
+
+	Eigen::Matrix2f get(unsigned int x, unsigned int y) const
+	{
+		return (*this)[size_t(y)*getWidth() + x];
+	}
+
+	// fn maps the matrix of every pixel to a value of the result
+	template<typename Fn>
+	auto transform(Fn&& fn) const
+	{
+		using P = std::invoke_result_t<Fn, const Eigen::Matrix2f&>;
+
+		CPUImage<P> result(getWidth(), getHeight(), 1);
+		#pragma omp parallel for
+		for(int i = 0; i < int(result.getData().size()); i++)
+			result[i] = fn((*this)[i]);
+
+		return result;
+	}
+
+	CPUImage<Eigen::Matrix2f> toMatrices() const
+	{
+		return transform([](const Eigen::Matrix2f& mtx) { return mtx; });
 	}
 
+private:
+	CPUImage<float> m_data;
+};
+
+// Scharr derivatives and their products smoothed with a Gaussian of sigma 1, fused
+// into a single pass so only the grayscale image and the result are full frames.
+template<typename T>
+SymmetricTensorImage StructureTensor(const CPUImage<T>& in)
+{
+	const auto gray = MakeGrayscale(ConvertType<T, float>(in));
+	SymmetricTensorImage output(in.getWidth(), in.getHeight());
+	CPUImage<float>& data = output.getData();
+
+	detail::StructureTensorRows(gray, [&](int y, const float* row) {
+		std::copy_n(row, size_t(data.getWidth())*3, data.get(0, y));
+	});
+
 	return output;
 }
 
+enum HESSIAN_RESPONSE
+{
+	HESSIAN_DETERMINANT,
+	HESSIAN_TRACE
+};
 
-template<typename T>
-CPUImage<Eigen::Matrix2f> HessianTensor(const CPUImage<T>& in)
+namespace detail
 {
-	auto gray = MakeGrayscale(ConvertType<T, float>(in));
-	auto sampler = ClampView(gray);
+// Sampled Gaussian of sigma and its first and second derivative over a radius of
+// ceil(3*sigma). The derivatives are corrected to be exact on polynomials up to the
+// second degree, which also keeps them usable for sigmas well below one pixel.
+inline std::array<std::vector<float>, 3> GaussDerivativeKernels(float sigma)
+{
+	const int r = std::max(1, int(std::ceil(3.0f*sigma)));
+	std::vector<float> g(2*r + 1), d1(2*r + 1), d2(2*r + 1);
 
-	gray = ConvoluteSeparable(sampler, GaussFilter<3>(0.25f));
+	float sum = 0.0f;
+	for(int k = -r; k <= r; k++)
+	{
+		g[k + r] = std::exp(-float(k*k)/(2.0f*sigma*sigma));
+		sum += g[k + r];
+	}
 
-	auto Dx = Convolute1D<HORIZONTAL>(sampler, LaplaceFilterX);
-	auto Dy = Convolute1D<VERTICAL>(sampler, LaplaceFilterX);
-	auto Dxy = Convolute2D(sampler, LaplaceFilterXY());
-	auto Dyx = Convolute2D(sampler, LaplaceFilterXY().transpose());
+	float moment = 0.0f;
+	for(int k = -r; k <= r; k++)
+	{
+		g[k + r] /= sum;
+		moment += k*k*g[k + r];
+	}
 
-	CPUImage<Eigen::Matrix2f> output(in.getWidth(), in.getHeight(), 1);
-	#pragma omp parallel for
-	for(int y = 0; y < in.getHeight(); y++)
+	float norm2 = 0.0f;
+	for(int k = -r; k <= r; k++)
 	{
-		const size_t yoff = y*in.getWidth();
-		for(int x = 0; x < in.getWidth(); x++)
-		{
-			const size_t off = yoff+x;
-			output[off] <<	ColorToFloat(Dx[off]), ColorToFloat(Dxy[off]),
-							ColorToFloat(Dyx[off]), ColorToFloat(Dy[off]);
-		}
+		d1[k + r] = k*g[k + r]/moment;
+		d2[k + r] = (k*k - moment)*g[k + r];
+		norm2 += k*k*d2[k + r];
 	}
 
+	for(float& v : d2)
+		v *= 2.0f/norm2;
+
+	return {g, d1, d2};
+}
+
+// Hessian of a grayscale image smoothed with a Gaussian of sigma in one pass over blocks
+// of rows: every input row is filtered horizontally with the Gaussian and its two
+// derivatives, a ring of those rows gives Dxx, Dxy and Dyy with one vertical kernel
+// each. Borders are clamped. store(y, row) gets every row as packed (xx, xy, yy) triples.
+template<typename Store>
+void HessianRows(const CPUImage<float>& gray, float sigma, Store&& store)
+{
+	assert(sigma > 0.0f && "The Hessian needs a positive sigma!");
+
+	const auto [g, d1, d2] = GaussDerivativeKernels(sigma);
+	const unsigned int size = g.size();
+	const int r = size/2;
+	const int w = gray.getWidth();
+	const size_t rowSize = size_t(w)*3;
+	const ClampView<float> sampler(gray);
+	const auto& kernels = Dispatch::getKernels();
+
+	// Horizontal kernel of every plane of a ring row and the vertical kernel it needs
+	const std::vector<float>* horizontal[] = {&d2, &d1, &g};
+	const std::vector<float>* vertical[] = {&g, &d1, &d2};
+
+	ForEachRowBlock(gray.getHeight(), std::max(RowBlockSize, 4*int(size)), [&](int y0, int y1) {
+		std::vector<float> padded(w + 2*r), planes(rowSize), result(rowSize);
+		std::vector<const float*> planeRows(size);
+
+		SlidingRows(y0, y1, size, rowSize,
+			[&](int y, float* dst) {
+				sampler.sampleRow(y, -r, w + r, padded.data());
+				for(int t = 0; t < 3; t++)
+					kernels.convolveRow(padded.data(), dst + t*w, w, horizontal[t]->data(), size, 1);
+			},
+			[&](int y, const float* const* rows) {
+				for(int t = 0; t < 3; t++)
+				{
+					for(unsigned int k = 0; k < size; k++)
+						planeRows[k] = rows[k] + t*w;
+
+					kernels.convolveColumns(planeRows.data(), &planes[t*w], w, vertical[t]->data(), size);
+				}
+
+				for(int x = 0; x < w; x++)
+				{
+					result[3*x] = planes[x];
+					result[3*x + 1] = planes[w + x];
+					result[3*x + 2] = planes[2*w + x];
+				}
+
+				store(y, result.data());
+			});
+	});
+}
+}
+
+// Hessian of the image smoothed with a Gaussian of sigma, in ColorToFloat units.
+template<typename T>
+SymmetricTensorImage HessianTensor(const CPUImage<T>& in, float sigma = 1.0f)
+{
+	const auto gray = MakeGrayscale(ConvertType<T, float>(in));
+	SymmetricTensorImage output(in.getWidth(), in.getHeight());
+	CPUImage<float>& data = output.getData();
+
+	detail::HessianRows(gray, sigma, [&](int y, const float* row) {
+		std::copy_n(row, size_t(data.getWidth())*3, data.get(0, y));
+	});
+
 	return output;
 }
 
+// Scale normalized determinant sigma^4*(Dxx*Dyy - Dxy^2) or trace sigma^2*(Dxx + Dyy),
+// the Laplacian of Gaussian, of the Hessian at sigma. Computed as the Hessian rows come
+// out, so the response is the only full frame besides the grayscale image.
+inline CPUImage<float> HessianResponse(const CPUImage<float>& gray, float sigma, HESSIAN_RESPONSE type = HESSIAN_DETERMINANT)
+{
+	const int w = gray.getWidth();
+	const float norm = sigma*sigma;
+	CPUImage<float> out(w, gray.getHeight(), 1);
+
+	detail::HessianRows(gray, sigma, [&](int y, const float* t) {
+		float* dst = out.get(0, y);
+		if(type == HESSIAN_DETERMINANT)
+		{
+			for(int x = 0; x < w; x++)
+				dst[x] = norm*norm*(t[3*x]*t[3*x + 2] - t[3*x + 1]*t[3*x + 1]);
+		}
+		else
+		{
+			for(int x = 0; x < w; x++)
+				dst[x] = norm*(t[3*x] + t[3*x + 2]);
+		}
+	});
+
+	return out;
+}
+
+// One response per sigma, the grayscale image is shared by all scales
+template<typename T>
+std::vector<CPUImage<float>> HessianResponse(const CPUImage<T>& in, const std::vector<float>& sigmas, HESSIAN_RESPONSE type = HESSIAN_DETERMINANT)
+{
+	const auto gray = MakeGrayscale(ConvertType<T, float>(in));
+
+	std::vector<CPUImage<float>> responses;
+	for(float sigma : sigmas)
+		responses.push_back(HessianResponse(gray, sigma, type));
+
+	return responses;
+}
+
 }
 
 #endif
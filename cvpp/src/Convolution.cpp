@@ -0,0 +1,68 @@
+#include <cvpp/Convolution.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+using namespace cvpp;
+
+static bool quantize(const std::vector<float>& kernel, unsigned int shift, detail::FixedPointKernel& result)
+{
+	const double scale = std::ldexp(1.0, shift);
+	const size_t n = kernel.size();
+
+	std::vector<long> q(n);
+	size_t largest = 0;
+	double sum = 0.0;
+	long total = 0;
+	for(size_t i = 0; i < n; i++)
+	{
+		q[i] = std::lround(kernel[i]*scale);
+		total += q[i];
+		sum += kernel[i];
+
+		if(std::abs(kernel[i]) > std::abs(kernel[largest]))
+			largest = i;
+	}
+
+	// The largest coefficient absorbs the rounding of the kernel sum
+	if(n)
+		q[largest] += std::lround(sum*scale) - total;
+
+	int64_t absSum = 0;
+	for(size_t i = 0; i < n; i++)
+	{
+		if(std::abs(q[i]) > std::numeric_limits<int16_t>::max())
+			return false;
+
+		absSum += std::abs(q[i]);
+	}
+
+	const int64_t half = shift ? int64_t(1) << (shift - 1) : 0;
+	if(255*absSum + half > std::numeric_limits<int32_t>::max())
+		return false;
+
+	result.shift = shift;
+	result.coefficients.assign(q.begin(), q.end());
+
+	double error = 0.0;
+	for(size_t i = 0; i < n; i++)
+		error += std::abs(double(kernel[i]) - double(q[i])/scale);
+
+	result.maxError = 255.0*error;
+	return true;
+}
+
+detail::FixedPointKernel cvpp::detail::QuantizeKernel(const std::vector<float>& kernel)
+{
+	constexpr unsigned int MaxShift = 24;
+
+	FixedPointKernel result;
+	result.maxError = std::numeric_limits<float>::infinity();
+
+	for(int shift = MaxShift; shift >= 0; shift--)
+		if(quantize(kernel, shift, result))
+			break;
+
+	return result;
+}
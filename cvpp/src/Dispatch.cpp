@@ -0,0 +1,148 @@
+#include <cvpp/Dispatch.h>
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace cvpp::Dispatch;
+
+#define CVPP_DECLARE_ISA(ns) namespace cvpp::Dispatch::ns { void fillKernels(KernelTable& table); }
+
+CVPP_DECLARE_ISA(generic)
+#ifdef CVPP_HAS_SSE42
+CVPP_DECLARE_ISA(sse42)
+#endif
+#ifdef CVPP_HAS_AVX2
+CVPP_DECLARE_ISA(avx2)
+#endif
+#ifdef CVPP_HAS_AVX512
+CVPP_DECLARE_ISA(avx512)
+#endif
+
+static bool cpuSupports(ISA_LEVEL level)
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	__builtin_cpu_init();
+	switch(level)
+	{
+		case GENERIC: return true;
+		case SSE42: return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt");
+		case AVX2: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("bmi2");
+		case AVX512: return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+						&& __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl");
+		default: return false;
+	}
+#else
+	return level == GENERIC;
+#endif
+}
+
+static const KernelTable* buildTable(ISA_LEVEL level)
+{
+	static KernelTable tables[ISA_COUNT];
+	auto* table = &tables[level];
+	table->level = level;
+
+	switch(level)
+	{
+		case GENERIC: generic::fillKernels(*table); return table;
+#ifdef CVPP_HAS_SSE42
+		case SSE42: sse42::fillKernels(*table); return table;
+#endif
+#ifdef CVPP_HAS_AVX2
+		case AVX2: avx2::fillKernels(*table); return table;
+#endif
+#ifdef CVPP_HAS_AVX512
+		case AVX512: avx512::fillKernels(*table); return table;
+#endif
+		default: return nullptr;
+	}
+}
+
+static ISA_LEVEL requestedISA()
+{
+	const char* env = std::getenv("CVPP_ISA");
+	if(!env)
+		return AVX512;
+
+	ISA_LEVEL level;
+	if(parseISAName(env, level))
+		return level;
+
+	std::fprintf(stderr, "cvpp: unknown CVPP_ISA value \"%s\", using generic kernels\n", env);
+	return GENERIC;
+}
+
+const KernelTable* cvpp::Dispatch::getKernels(ISA_LEVEL level)
+{
+	static const auto tables = []() {
+		struct { const KernelTable* table[ISA_COUNT]; } result = {};
+		for(int i = 0; i < ISA_COUNT; i++)
+			if(cpuSupports(ISA_LEVEL(i)))
+				result.table[i] = buildTable(ISA_LEVEL(i));
+		return result;
+	}();
+
+	if(level < GENERIC || level >= ISA_COUNT)
+		return nullptr;
+
+	return tables.table[level];
+}
+
+const KernelTable& cvpp::Dispatch::getKernels()
+{
+	static const KernelTable& table = []() -> const KernelTable& {
+		for(int i = requestedISA(); i > GENERIC; i--)
+			if(auto* t = getKernels(ISA_LEVEL(i)))
+				return *t;
+
+		return *getKernels(GENERIC);
+	}();
+
+	return table;
+}
+
+ISA_LEVEL cvpp::Dispatch::getISA()
+{
+	return getKernels().level;
+}
+
+const char* cvpp::Dispatch::getISAName(ISA_LEVEL level)
+{
+	switch(level)
+	{
+		case GENERIC: return "generic";
+		case SSE42: return "sse4.2";
+		case AVX2: return "avx2";
+		case AVX512: return "avx512";
+		default: return "unknown";
+	}
+}
+
+bool cvpp::Dispatch::parseISAName(const char* name, ISA_LEVEL& level)
+{
+	// Compare case insensitively and skip separators so "sse42", "SSE4_2" and "avx-512" are accepted as well.
+	auto matches = [](const char* a, const char* b) {
+		for(;; a++, b++)
+		{
+			while(*a == '.' || *a == '_' || *a == '-')
+				a++;
+			while(*b == '.' || *b == '_' || *b == '-')
+				b++;
+			if(std::tolower((unsigned char) *a) != std::tolower((unsigned char) *b))
+				return false;
+			if(!*a)
+				return true;
+		}
+	};
+
+	for(int i = 0; i < ISA_COUNT; i++)
+		if(matches(name, getISAName(ISA_LEVEL(i))))
+		{
+			level = ISA_LEVEL(i);
+			return true;
+		}
+
+	return false;
+}
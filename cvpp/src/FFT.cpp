@@ -0,0 +1,137 @@
+#include <cvpp/FFT.h>
+#include <cvpp/Dispatch.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <utility>
+
+using namespace cvpp;
+
+FFT::FFT(size_t size):
+	m_size(size)
+{
+	assert(size && (size & (size - 1)) == 0 && "The FFT size needs to be a power of two!");
+
+	unsigned int bits = 0;
+	while((size_t(1) << bits) < size)
+		bits++;
+
+	m_reversed.resize(size);
+	for(size_t i = 0; i < size; i++)
+	{
+		unsigned int r = 0;
+		for(unsigned int b = 0; b < bits; b++)
+			r |= ((i >> b) & 1) << (bits - 1 - b);
+
+		m_reversed[i] = r;
+	}
+
+	m_twiddlesRe.resize(size/2);
+	m_twiddlesIm.resize(size/2);
+	for(size_t i = 0; i < size/2; i++)
+	{
+		const double angle = -2.0*M_PI*double(i)/double(size);
+		m_twiddlesRe[i] = std::cos(angle);
+		m_twiddlesIm[i] = std::sin(angle);
+	}
+}
+
+size_t FFT::NextPowerOfTwo(size_t n)
+{
+	size_t p = 1;
+	while(p < n)
+		p <<= 1;
+
+	return p;
+}
+
+void FFT::transformColumns(float* re, float* im, bool inverse) const
+{
+	const size_t n = m_size;
+	const auto& kernels = Dispatch::getKernels();
+
+	for(size_t i = 0; i < n; i++)
+	{
+		if(i < m_reversed[i])
+		{
+			std::swap_ranges(re + i*n, re + (i + 1)*n, re + m_reversed[i]*n);
+			std::swap_ranges(im + i*n, im + (i + 1)*n, im + m_reversed[i]*n);
+		}
+	}
+
+	const float sign = inverse ? -1.0f : 1.0f;
+	for(size_t half = 1; half < n; half <<= 1)
+	{
+		const size_t step = n/(2*half);
+		for(size_t start = 0; start < n; start += 2*half)
+		{
+			for(size_t k = 0; k < half; k++)
+			{
+				const size_t a = (start + k)*n;
+				const size_t b = (start + k + half)*n;
+				kernels.butterfly(re + a, im + a, re + b, im + b, n, m_twiddlesRe[k*step], sign*m_twiddlesIm[k*step]);
+			}
+		}
+	}
+}
+
+void FFT::transpose(float* data) const
+{
+	constexpr size_t Block = 16;
+	const size_t n = m_size;
+
+	for(size_t by = 0; by < n; by += Block)
+	{
+		for(size_t bx = by; bx < n; bx += Block)
+		{
+			const size_t yEnd = std::min(by + Block, n);
+			const size_t xEnd = std::min(bx + Block, n);
+			for(size_t y = by; y < yEnd; y++)
+				for(size_t x = (bx == by ? y + 1 : bx); x < xEnd; x++)
+					std::swap(data[y*n + x], data[x*n + y]);
+		}
+	}
+}
+
+void FFT::forward2D(float* re, float* im) const
+{
+	transformColumns(re, im, false);
+	transpose(re);
+	transpose(im);
+	transformColumns(re, im, false);
+}
+
+void FFT::inverse2D(float* re, float* im) const
+{
+	transformColumns(re, im, true);
+	transpose(re);
+	transpose(im);
+	transformColumns(re, im, true);
+}
+
+unsigned int cvpp::FFTTileSize(unsigned int w, unsigned int h, unsigned int kernelSize)
+{
+	constexpr size_t MaxTileSize = 512;
+
+	// A single tile covering the whole image is never beaten by bigger ones
+	const size_t first = FFT::NextPowerOfTwo(kernelSize + 1);
+	const size_t last = std::max(first, std::min(FFT::NextPowerOfTwo(std::max(w, h) + kernelSize - 1), MaxTileSize));
+
+	size_t best = 0;
+	double bestCost = 0.0;
+	for(size_t n = first; n <= last; n <<= 1)
+	{
+		const size_t valid = n - kernelSize + 1;
+		const size_t tiles = ((w + valid - 1)/valid)*((h + valid - 1)/valid);
+		const double cost = double(tiles)*n*n*std::log2(double(n));
+
+		if(!best || cost < bestCost)
+		{
+			best = n;
+			bestCost = cost;
+		}
+	}
+
+	return best;
+}
@@ -0,0 +1,60 @@
+#include <cvpp/KernelDecomposition.h>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <cstring>
+
+using namespace cvpp;
+
+static KernelDecomposition decompose(const Eigen::MatrixXf& kernel, float tolerance)
+{
+	KernelDecomposition result;
+	const unsigned int size = kernel.rows();
+	if(size == 0 || kernel.isZero(0.0f))
+		return result;
+
+	Eigen::JacobiSVD<Eigen::MatrixXf> svd(kernel, Eigen::ComputeFullU | Eigen::ComputeFullV);
+	const auto& sigma = svd.singularValues();
+
+	unsigned int rank = 0;
+	while(rank < sigma.size() && sigma[rank] > tolerance*sigma[0])
+		rank++;
+
+	// Every term costs two 1D passes of 'size' taps each.
+	if(2*rank*size >= size*size)
+		return result;
+
+	for(unsigned int i = 0; i < rank; i++)
+	{
+		const float s = std::sqrt(sigma[i]);
+		result.vertical.push_back(svd.matrixU().col(i)*s);
+		result.horizontal.push_back(svd.matrixV().col(i)*s);
+	}
+
+	return result;
+}
+
+KernelDecomposition cvpp::DecomposeKernel(const Eigen::MatrixXf& kernel, float tolerance)
+{
+	constexpr size_t MaxCacheSize = 256;
+
+	static std::mutex mutex;
+	static std::unordered_map<std::string, KernelDecomposition> cache;
+
+	const Eigen::Index rows = kernel.rows();
+	std::string key(sizeof(rows) + sizeof(tolerance) + sizeof(float)*kernel.size(), '\0');
+	std::memcpy(key.data(), &rows, sizeof(rows));
+	std::memcpy(key.data() + sizeof(rows), &tolerance, sizeof(tolerance));
+	std::memcpy(key.data() + sizeof(rows) + sizeof(tolerance), kernel.data(), sizeof(float)*kernel.size());
+
+	std::lock_guard<std::mutex> g(mutex);
+	auto entry = cache.find(key);
+	if(entry != cache.end())
+		return entry->second;
+
+	if(cache.size() >= MaxCacheSize)
+		cache.clear();
+
+	return cache.emplace(key, decompose(kernel, tolerance)).first->second;
+}
@@ -0,0 +1,98 @@
+#include <cvpp/Remap.h>
+#include <limits>
+
+using namespace cvpp;
+
+const std::array<RemapTable::Weights, RemapTable::FractionSteps*RemapTable::FractionSteps>& RemapTable::getWeights()
+{
+	static const auto table = []() {
+		std::array<Weights, FractionSteps*FractionSteps> table;
+		for(int fy = 0; fy < FractionSteps; fy++)
+		{
+			for(int fx = 0; fx < FractionSteps; fx++)
+			{
+				const float ax = float(fx)/FractionSteps;
+				const float ay = float(fy)/FractionSteps;
+				auto& w = table[fy*FractionSteps + fx];
+
+				w.real[0] = (1.0f - ax)*(1.0f - ay);
+				w.real[1] = ax*(1.0f - ay);
+				w.real[2] = (1.0f - ax)*ay;
+				w.real[3] = ax*ay;
+
+				// The fixed-point weights have to add up to exactly one so flat regions stay flat.
+				int sum = 0;
+				for(int i = 1; i < 4; i++)
+				{
+					w.fixed[i] = int16_t(std::lround(w.real[i]*WeightOne));
+					sum += w.fixed[i];
+				}
+				w.fixed[0] = int16_t(WeightOne - sum);
+			}
+		}
+		return table;
+	}();
+
+	return table;
+}
+
+const std::array<int32_t, 2*RemapTable::FractionSteps*RemapTable::FractionSteps>& RemapTable::getWeightPairs()
+{
+	static const auto table = []() {
+		std::array<int32_t, 2*FractionSteps*FractionSteps> table;
+		const auto& weights = getWeights();
+		for(size_t f = 0; f < weights.size(); f++)
+		{
+			const int16_t* fixed = weights[f].fixed;
+			table[2*f] = int32_t(uint16_t(fixed[0])) | (int32_t(fixed[1]) << 16);
+			table[2*f + 1] = int32_t(uint16_t(fixed[2])) | (int32_t(fixed[3]) << 16);
+		}
+		return table;
+	}();
+
+	return table;
+}
+
+void RemapTable::set(unsigned int x, unsigned int y, const Eigen::Vector2f& src)
+{
+	constexpr float Limit = std::numeric_limits<int16_t>::max() - 2;
+
+	const float sx = std::clamp(src.x(), -Limit, Limit);
+	const float sy = std::clamp(src.y(), -Limit, Limit);
+
+	int ix = std::lround(sx*FractionSteps);
+	int iy = std::lround(sy*FractionSteps);
+
+	const size_t idx = x + size_t(y)*m_width;
+	m_coords[idx*2] = int16_t(ix >> FractionBits);
+	m_coords[idx*2 + 1] = int16_t(iy >> FractionBits);
+	m_fractions[idx] = uint16_t((iy & (FractionSteps - 1))*FractionSteps + (ix & (FractionSteps - 1)));
+}
+
+RemapTable RemapTable::Undistortion(unsigned int w, unsigned int h, const Eigen::Matrix3f& K, const Eigen::Matrix<float, 5, 1>& dist)
+{
+	return Rectification(w, h, K, dist, Eigen::Matrix3f::Identity(), K);
+}
+
+RemapTable RemapTable::Rectification(unsigned int w, unsigned int h, const Eigen::Matrix3f& K, const Eigen::Matrix<float, 5, 1>& dist,
+									const Eigen::Matrix3f& R, const Eigen::Matrix3f& P)
+{
+	const Eigen::Matrix3f iPR = (P*R).inverse();
+
+	const float fx = K(0, 0), fy = K(1, 1);
+	const float cx = K(0, 2), cy = K(1, 2);
+	const float k1 = dist[0], k2 = dist[1], p1 = dist[2], p2 = dist[3], k3 = dist[4];
+
+	return RemapTable(w, h, [&](int u, int v) -> Eigen::Vector2f {
+		const Eigen::Vector3f ray = iPR*Eigen::Vector3f(u, v, 1.0f);
+		const float x = ray.x()/ray.z();
+		const float y = ray.y()/ray.z();
+
+		const float r2 = x*x + y*y;
+		const float radial = 1.0f + r2*(k1 + r2*(k2 + r2*k3));
+		const float xd = x*radial + 2.0f*p1*x*y + p2*(r2 + 2.0f*x*x);
+		const float yd = y*radial + p1*(r2 + 2.0f*y*y) + 2.0f*p2*x*y;
+
+		return Eigen::Vector2f(fx*xd + cx, fy*yd + cy);
+	});
+}
@@ -0,0 +1,467 @@
+// This file is compiled once per instruction set with CVPP_ISA set to the
+// namespace of that level (see cvpp/CMakeLists.txt). Everything except the
+// fill function has internal linkage: an inline function shared with other
+// translation units could be merged by the linker with the copy built for a
+// wider instruction set and crash older CPUs.
+
+#include <cvpp/Dispatch.h>
+#include "Simd.h"
+
+#ifndef CVPP_ISA
+#error "CVPP_ISA needs to be defined when compiling the kernels!"
+#endif
+
+namespace
+{
+
+constexpr size_t BlockSize = 256;
+
+inline float clamp01(float v)
+{
+	return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+}
+
+template<typename T>
+void toFloat(const T* in, float* out, size_t count)
+{
+	constexpr float Max = T(~T(0));
+	for(size_t i = 0; i < count; i++)
+		out[i] = float(in[i]) / Max;
+}
+
+template<typename T>
+void fromFloat(const float* in, T* out, size_t count)
+{
+	constexpr float Max = T(~T(0));
+	for(size_t i = 0; i < count; i++)
+		out[i] = T(clamp01(in[i]) * Max);
+}
+
+void u8ToFloat(const uint8_t* in, float* out, size_t count)
+{
+	constexpr size_t W = VecF::Width;
+	const VecF scale = VecF::set1(255.0f);
+
+	size_t i = 0;
+	for(; i + W <= count; i += W)
+		(VecF::loadU8(in + i) / scale).store(out + i);
+
+	for(; i < count; i++)
+		out[i] = float(in[i]) / 255.0f;
+}
+
+void floatToU8(const float* in, uint8_t* out, size_t count)
+{
+	constexpr size_t W = VecF::Width;
+	const VecF zero = VecF::zero();
+	const VecF one = VecF::set1(1.0f);
+	const VecF scale = VecF::set1(255.0f);
+
+	size_t i = 0;
+	for(; i + W <= count; i += W)
+		(min(max(VecF::load(in + i), zero), one) * scale).storeU8(out + i);
+
+	for(; i < count; i++)
+		out[i] = uint8_t(clamp01(in[i]) * 255.0f);
+}
+
+template<unsigned int Comps>
+void grayscale(const float* in, float* out, size_t pixels, unsigned int comps, const float* weights)
+{
+	const unsigned int n = (Comps ? Comps : comps);
+	for(size_t i = 0; i < pixels; i++)
+	{
+		float sum = 0.0f;
+		for(unsigned int c = 0; c < n; c++)
+			sum += weights[c] * in[i*n + c];
+
+		out[i] = sum / n;
+	}
+}
+
+// The usual channel counts get loops the compiler can vectorize
+void grayscale(const float* in, float* out, size_t pixels, unsigned int comps, const float* weights)
+{
+	switch(comps)
+	{
+	case 1: grayscale<1>(in, out, pixels, comps, weights); break;
+	case 2: grayscale<2>(in, out, pixels, comps, weights); break;
+	case 3: grayscale<3>(in, out, pixels, comps, weights); break;
+	case 4: grayscale<4>(in, out, pixels, comps, weights); break;
+	default: grayscale<0>(in, out, pixels, comps, weights);
+	}
+}
+
+void add(const float* a, const float* b, float* out, size_t count)
+{
+	for(size_t i = 0; i < count; i++)
+		out[i] = a[i] + b[i];
+}
+
+void sub(const float* a, const float* b, float* out, size_t count)
+{
+	for(size_t i = 0; i < count; i++)
+		out[i] = a[i] - b[i];
+}
+
+void mul(const float* a, const float* b, float* out, size_t count)
+{
+	for(size_t i = 0; i < count; i++)
+		out[i] = a[i] * b[i];
+}
+
+void div(const float* a, const float* b, float* out, size_t count)
+{
+	for(size_t i = 0; i < count; i++)
+		out[i] = a[i] / b[i];
+}
+
+// Cephes expf: e^x = 2^n*e^r with n = round(x/ln 2) and |r| <= ln(2)/2, where ln 2 is
+// split in two so r stays exact, and a polynomial for e^r.
+void exponential(const float* in, float* out, size_t count)
+{
+	constexpr size_t W = VecF::Width;
+	const VecF lo = VecF::set1(-87.3f);
+	const VecF hi = VecF::set1(88.3f);
+	const VecF log2e = VecF::set1(1.44269504088896341f);
+	const VecF ln2Hi = VecF::set1(-0.693359375f);
+	const VecF ln2Lo = VecF::set1(2.12194440e-4f);
+	const VecF one = VecF::set1(1.0f);
+	const float poly[] = {1.9875691500e-4f, 1.3981999507e-3f, 8.3334519073e-3f, 4.1665795894e-2f, 1.6666665459e-1f, 5.0000001201e-1f};
+
+	size_t i = 0;
+	for(; i + W <= count; i += W)
+	{
+		const VecF x = min(max(VecF::load(in + i), lo), hi);
+		const VecF n = round(x*log2e);
+		const VecF r = fmadd(n, ln2Lo, fmadd(n, ln2Hi, x));
+
+		VecF p = VecF::set1(poly[0]);
+		for(int k = 1; k < 6; k++)
+			p = fmadd(p, r, VecF::set1(poly[k]));
+
+		(fmadd(p, r*r, r + one)*VecF::pow2(n)).store(out + i);
+	}
+
+	for(; i < count; i++)
+		out[i] = std::exp(in[i]);
+}
+
+double sum(const float* in, size_t count)
+{
+	// Blocked so the inner loop can vectorize in float while the total stays precise.
+	double total = 0.0;
+	for(size_t i = 0; i < count; i += BlockSize)
+	{
+		const size_t n = (count - i < BlockSize ? count - i : BlockSize);
+		float partial = 0.0f;
+		for(size_t j = 0; j < n; j++)
+			partial += in[i + j];
+
+		total += partial;
+	}
+	return total;
+}
+
+void minMax(const float* in, size_t count, float& min, float& max)
+{
+	float lo = count ? in[0] : 0.0f;
+	float hi = lo;
+	for(size_t i = 0; i < count; i++)
+	{
+		lo = in[i] < lo ? in[i] : lo;
+		hi = in[i] > hi ? in[i] : hi;
+	}
+
+	min = lo;
+	max = hi;
+}
+
+// The convolution kernels vectorize across output elements: with interleaved
+// channels element i + 1 is the next channel or pixel, so 1, 3 and 4 channel
+// rows all use full vectors. Four vectors of accumulators stay in registers
+// for all taps, tap (r, t) reads rows[r] + t*stride.
+inline void convolveBlocks(float* out, size_t count, const float* const* rows, unsigned int rowCount,
+							unsigned int rowTaps, unsigned int stride, const float* kernel)
+{
+	constexpr size_t W = VecF::Width;
+
+	size_t i = 0;
+	for(; i + 4*W <= count; i += 4*W)
+	{
+		VecF a0 = VecF::zero(), a1 = VecF::zero(), a2 = VecF::zero(), a3 = VecF::zero();
+		const float* k = kernel;
+		for(unsigned int r = 0; r < rowCount; r++)
+		{
+			const float* p = rows[r] + i;
+			for(unsigned int t = 0; t < rowTaps; t++, k++, p += stride)
+			{
+				const VecF w = VecF::set1(*k);
+				a0 = fmadd(w, VecF::load(p), a0);
+				a1 = fmadd(w, VecF::load(p + W), a1);
+				a2 = fmadd(w, VecF::load(p + 2*W), a2);
+				a3 = fmadd(w, VecF::load(p + 3*W), a3);
+			}
+		}
+
+		a0.store(out + i);
+		a1.store(out + i + W);
+		a2.store(out + i + 2*W);
+		a3.store(out + i + 3*W);
+	}
+
+	for(; i + W <= count; i += W)
+	{
+		VecF a = VecF::zero();
+		const float* k = kernel;
+		for(unsigned int r = 0; r < rowCount; r++)
+		{
+			const float* p = rows[r] + i;
+			for(unsigned int t = 0; t < rowTaps; t++, k++, p += stride)
+				a = fmadd(VecF::set1(*k), VecF::load(p), a);
+		}
+
+		a.store(out + i);
+	}
+
+	for(; i < count; i++)
+	{
+		float a = 0.0f;
+		const float* k = kernel;
+		for(unsigned int r = 0; r < rowCount; r++)
+		{
+			const float* p = rows[r] + i;
+			for(unsigned int t = 0; t < rowTaps; t++, k++, p += stride)
+				a += *k * *p;
+		}
+
+		out[i] = a;
+	}
+}
+
+void convolveRow(const float* in, float* out, size_t count, const float* kernel, unsigned int size, unsigned int stride)
+{
+	convolveBlocks(out, count, &in, 1, size, stride, kernel);
+}
+
+void convolveColumns(const float* const* rows, float* out, size_t count, const float* kernel, unsigned int size)
+{
+	convolveBlocks(out, count, rows, size, 1, 0, kernel);
+}
+
+void convolve2D(const float* const* rows, float* out, size_t count, const float* kernel, unsigned int size, unsigned int stride)
+{
+	convolveBlocks(out, count, rows, size, size, stride, kernel);
+}
+
+
+// Fixed point counterpart of convolveBlocks for 8 bit rows: pairs of taps are
+// multiplied and summed to 32 bit in one step, the sums are rounded, shifted
+// by 'shift' and saturated once at the end.
+void convolveU8(const uint8_t* const* rows, uint8_t* out, size_t count, const int16_t* kernel, unsigned int rowCount,
+				unsigned int rowTaps, unsigned int stride, unsigned int shift)
+{
+	const unsigned int taps = rowCount*rowTaps;
+	const int32_t half = shift ? 1 << (shift - 1) : 0;
+
+	// Walks the taps in kernel order without divisions
+	struct Taps
+	{
+		const uint8_t* const* rows;
+		unsigned int rowTaps, stride, r = 0, t = 0;
+
+		const uint8_t* next()
+		{
+			const uint8_t* p = rows[r] + t*stride;
+			if(++t == rowTaps)
+			{
+				t = 0;
+				r++;
+			}
+			return p;
+		}
+	};
+
+	size_t i = 0;
+#ifdef CVPP_SIMD_INT
+	constexpr size_t W = VecI::Width;
+	for(; i + 2*W <= count; i += 2*W)
+	{
+		VecI lo0 = VecI::set1(half), hi0 = lo0, lo1 = lo0, hi1 = lo0;
+		Taps tap{rows, rowTaps, stride};
+
+		unsigned int k = 0;
+		for(; k + 1 < taps; k += 2)
+		{
+			const uint8_t* p = tap.next() + i;
+			const uint8_t* q = tap.next() + i;
+			const VecI w = VecI::pair(kernel[k], kernel[k + 1]);
+
+			const VecI a0 = VecI::loadU8(p), b0 = VecI::loadU8(q);
+			const VecI a1 = VecI::loadU8(p + W), b1 = VecI::loadU8(q + W);
+			lo0 = lo0 + madd(unpackLo(a0, b0), w);
+			hi0 = hi0 + madd(unpackHi(a0, b0), w);
+			lo1 = lo1 + madd(unpackLo(a1, b1), w);
+			hi1 = hi1 + madd(unpackHi(a1, b1), w);
+		}
+
+		if(k < taps)
+		{
+			const uint8_t* p = tap.next() + i;
+			const VecI w = VecI::pair(kernel[k], 0);
+			const VecI a0 = VecI::loadU8(p), a1 = VecI::loadU8(p + W);
+			lo0 = lo0 + madd(unpackLo(a0, a0), w);
+			hi0 = hi0 + madd(unpackHi(a0, a0), w);
+			lo1 = lo1 + madd(unpackLo(a1, a1), w);
+			hi1 = hi1 + madd(unpackHi(a1, a1), w);
+		}
+
+		VecI::storeU8(out + i, lo0, hi0, shift);
+		VecI::storeU8(out + i + W, lo1, hi1, shift);
+	}
+
+	for(; i + W <= count; i += W)
+	{
+		VecI lo = VecI::set1(half), hi = lo;
+		Taps tap{rows, rowTaps, stride};
+
+		unsigned int k = 0;
+		for(; k + 1 < taps; k += 2)
+		{
+			const VecI a = VecI::loadU8(tap.next() + i);
+			const VecI b = VecI::loadU8(tap.next() + i);
+			const VecI w = VecI::pair(kernel[k], kernel[k + 1]);
+			lo = lo + madd(unpackLo(a, b), w);
+			hi = hi + madd(unpackHi(a, b), w);
+		}
+
+		if(k < taps)
+		{
+			const VecI a = VecI::loadU8(tap.next() + i);
+			const VecI w = VecI::pair(kernel[k], 0);
+			lo = lo + madd(unpackLo(a, a), w);
+			hi = hi + madd(unpackHi(a, a), w);
+		}
+
+		VecI::storeU8(out + i, lo, hi, shift);
+	}
+#endif
+
+	for(; i < count; i++)
+	{
+		Taps tap{rows, rowTaps, stride};
+		int32_t acc = half;
+		for(unsigned int k = 0; k < taps; k++)
+			acc += kernel[k]*tap.next()[i];
+
+		acc >>= shift;
+		out[i] = uint8_t(acc < 0 ? 0 : (acc > 255 ? 255 : acc));
+	}
+}
+
+void butterfly(float* aRe, float* aIm, float* bRe, float* bIm, size_t count, float wRe, float wIm)
+{
+	constexpr size_t W = VecF::Width;
+	const VecF wr = VecF::set1(wRe);
+	const VecF wi = VecF::set1(wIm);
+
+	size_t i = 0;
+	for(; i + W <= count; i += W)
+	{
+		const VecF br = VecF::load(bRe + i);
+		const VecF bi = VecF::load(bIm + i);
+		const VecF tr = wr*br - wi*bi;
+		const VecF ti = fmadd(wr, bi, wi*br);
+		const VecF ar = VecF::load(aRe + i);
+		const VecF ai = VecF::load(aIm + i);
+
+		(ar - tr).store(bRe + i);
+		(ai - ti).store(bIm + i);
+		(ar + tr).store(aRe + i);
+		(ai + ti).store(aIm + i);
+	}
+
+	for(; i < count; i++)
+	{
+		const float tr = wRe*bRe[i] - wIm*bIm[i];
+		const float ti = wRe*bIm[i] + wIm*bRe[i];
+		bRe[i] = aRe[i] - tr;
+		bIm[i] = aIm[i] - ti;
+		aRe[i] += tr;
+		aIm[i] += ti;
+	}
+}
+
+
+// Taps come from gathers of whole words: p[0] is the low byte of the word at p and p[step]
+// the low byte of the word at p + step, or of the same word shifted if step < 4. Pairs of
+// taps end up as 16 bit halves of a lane, so madd weighs and sums a row in one step.
+void bilinearU8(const uint8_t* in, const int32_t* offsets, const uint16_t* fractions, const int32_t* weights,
+				uint8_t* out, size_t count, unsigned int step, size_t stride, unsigned int shift)
+{
+	const int32_t half = 1 << (shift - 1);
+
+	size_t i = 0;
+#ifdef CVPP_SIMD_GATHER
+	constexpr size_t W = VecG::Width;
+	const VecG low = VecG::set1(0xff);
+
+	auto pairs = [&](const uint8_t* row, VecG o) {
+		const VecG a = VecG::gather<1>(row, o);
+		const VecG b = (step < 4 ? a >> 8*step : VecG::gather<1>(row + step, o));
+		return (a & low) + ((b & low) << 16);
+	};
+
+	for(; i + W <= count; i += W)
+	{
+		const VecG o = VecG::load(offsets + i);
+		const VecG f = VecG::loadU16(fractions + i);
+		const VecG f2 = f + f;
+
+		const VecG sum = madd(pairs(in, o), VecG::gather<4>(weights, f2))
+						+ madd(pairs(in + stride, o), VecG::gather<4>(weights + 1, f2)) + VecG::set1(half);
+		(sum >> shift).storeU8(out + i);
+	}
+#endif
+
+	for(; i < count; i++)
+	{
+		const uint8_t* p = in + offsets[i];
+		const int32_t* w = weights + 2*fractions[i];
+		const int32_t sum = (w[0] & 0xffff)*p[0] + (w[0] >> 16)*p[step] + (w[1] & 0xffff)*p[stride] + (w[1] >> 16)*p[stride + step];
+		out[i] = uint8_t((sum + half) >> shift);
+	}
+}
+
+}
+
+namespace cvpp::Dispatch::CVPP_ISA
+{
+
+void fillKernels(KernelTable& table)
+{
+	table.u8ToFloat = u8ToFloat;
+	table.u16ToFloat = toFloat<uint16_t>;
+	table.floatToU8 = floatToU8;
+	table.floatToU16 = fromFloat<uint16_t>;
+	table.grayscale = grayscale;
+
+	table.add = add;
+	table.sub = sub;
+	table.mul = mul;
+	table.div = div;
+	table.exp = exponential;
+
+	table.sum = sum;
+	table.minMax = minMax;
+
+	table.convolveRow = convolveRow;
+	table.convolveColumns = convolveColumns;
+	table.convolve2D = convolve2D;
+	table.convolveU8 = convolveU8;
+	table.bilinearU8 = bilinearU8;
+
+	table.butterfly = butterfly;
+}
+
+}
@@ -0,0 +1,305 @@
+#ifndef __CVPP_KERNELS_SIMD_H__
+#define __CVPP_KERNELS_SIMD_H__
+
+// Thin wrapper over the widest float vector of the instruction set this
+// translation unit is compiled for. Only meant to be included by Kernels.cpp,
+// everything lives in an anonymous namespace for the reasons given there.
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+
+#if defined(__AVX512F__)
+
+struct VecF
+{
+	static constexpr size_t Width = 16;
+	__m512 v;
+
+	static VecF zero() { return {_mm512_setzero_ps()}; }
+	static VecF set1(float f) { return {_mm512_set1_ps(f)}; }
+	static VecF load(const float* p) { return {_mm512_loadu_ps(p)}; }
+	void store(float* p) const { _mm512_storeu_ps(p, v); }
+
+	static VecF loadU8(const uint8_t* p)
+	{
+		return {_mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))))};
+	}
+
+	// Truncates like FloatToColor, values need to be in [0, 255] already
+	void storeU8(uint8_t* p) const
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm512_cvtusepi32_epi8(_mm512_cvttps_epi32(v)));
+	}
+
+	friend VecF operator+(VecF a, VecF b) { return {_mm512_add_ps(a.v, b.v)}; }
+	friend VecF operator-(VecF a, VecF b) { return {_mm512_sub_ps(a.v, b.v)}; }
+	friend VecF operator*(VecF a, VecF b) { return {_mm512_mul_ps(a.v, b.v)}; }
+	friend VecF operator/(VecF a, VecF b) { return {_mm512_div_ps(a.v, b.v)}; }
+	friend VecF min(VecF a, VecF b) { return {_mm512_min_ps(a.v, b.v)}; }
+	friend VecF max(VecF a, VecF b) { return {_mm512_max_ps(a.v, b.v)}; }
+	friend VecF fmadd(VecF a, VecF b, VecF c) { return {_mm512_fmadd_ps(a.v, b.v, c.v)}; }
+
+	// Nearest integer, and 2^n for an integral n within the range of normal floats
+	friend VecF round(VecF a) { return {_mm512_cvtepi32_ps(_mm512_cvtps_epi32(a.v))}; }
+	static VecF pow2(VecF n) { return {_mm512_castsi512_ps(_mm512_slli_epi32(_mm512_add_epi32(_mm512_cvtps_epi32(n.v), _mm512_set1_epi32(127)), 23))}; }
+};
+
+// Integer lanes of the fixed point kernels: Width bytes are widened to 16 bit,
+// unpackLo/unpackHi interleave two of those so madd multiplies them with a pair
+// of 16 bit coefficients and sums to 32 bit. storeU8 shifts and saturates the
+// two halves and writes the bytes back in their original order.
+#ifdef __AVX512BW__
+#define CVPP_SIMD_INT 1
+
+struct VecI
+{
+	static constexpr size_t Width = 32;
+	__m512i v;
+
+	static VecI set1(int32_t i) { return {_mm512_set1_epi32(i)}; }
+	static VecI pair(int16_t a, int16_t b) { return {_mm512_set1_epi32(int32_t(uint16_t(a)) | (int32_t(b) << 16))}; }
+	static VecI loadU8(const uint8_t* p) { return {_mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)))}; }
+
+	static void storeU8(uint8_t* p, VecI lo, VecI hi, unsigned int shift)
+	{
+		const __m128i s = _mm_cvtsi32_si128(shift);
+		const __m512i w = _mm512_packs_epi32(_mm512_sra_epi32(lo.v, s), _mm512_sra_epi32(hi.v, s));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm512_cvtusepi16_epi8(_mm512_max_epi16(w, _mm512_setzero_si512())));
+	}
+
+	friend VecI unpackLo(VecI a, VecI b) { return {_mm512_unpacklo_epi16(a.v, b.v)}; }
+	friend VecI unpackHi(VecI a, VecI b) { return {_mm512_unpackhi_epi16(a.v, b.v)}; }
+	friend VecI madd(VecI a, VecI b) { return {_mm512_madd_epi16(a.v, b.v)}; }
+	friend VecI operator+(VecI a, VecI b) { return {_mm512_add_epi32(a.v, b.v)}; }
+};
+
+// 32 bit lanes loaded with hardware gathers, for table lookups of the remap kernel.
+// gather reads the words at base + Scale*offsets[i] bytes.
+#define CVPP_SIMD_GATHER 1
+
+struct VecG
+{
+	static constexpr size_t Width = 16;
+	__m512i v;
+
+	static VecG set1(int32_t i) { return {_mm512_set1_epi32(i)}; }
+	static VecG load(const int32_t* p) { return {_mm512_loadu_si512(p)}; }
+	static VecG loadU16(const uint16_t* p) { return {_mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)))}; }
+
+	template<int Scale>
+	static VecG gather(const void* base, VecG offsets) { return {_mm512_i32gather_epi32(offsets.v, base, Scale)}; }
+
+	// Lanes need to be in [0, 255] already
+	void storeU8(uint8_t* p) const { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm512_cvtepi32_epi8(v)); }
+
+	friend VecG operator+(VecG a, VecG b) { return {_mm512_add_epi32(a.v, b.v)}; }
+	friend VecG operator&(VecG a, VecG b) { return {_mm512_and_si512(a.v, b.v)}; }
+	friend VecG operator<<(VecG a, unsigned int n) { return {_mm512_sll_epi32(a.v, _mm_cvtsi32_si128(n))}; }
+	friend VecG operator>>(VecG a, unsigned int n) { return {_mm512_srl_epi32(a.v, _mm_cvtsi32_si128(n))}; }
+	friend VecG madd(VecG a, VecG b) { return {_mm512_madd_epi16(a.v, b.v)}; }
+};
+#endif
+
+#elif defined(__AVX2__)
+
+struct VecF
+{
+	static constexpr size_t Width = 8;
+	__m256 v;
+
+	static VecF zero() { return {_mm256_setzero_ps()}; }
+	static VecF set1(float f) { return {_mm256_set1_ps(f)}; }
+	static VecF load(const float* p) { return {_mm256_loadu_ps(p)}; }
+	void store(float* p) const { _mm256_storeu_ps(p, v); }
+
+	static VecF loadU8(const uint8_t* p)
+	{
+		return {_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))))};
+	}
+
+	void storeU8(uint8_t* p) const
+	{
+		const __m256i i = _mm256_cvttps_epi32(v);
+		const __m128i p16 = _mm_packus_epi32(_mm256_castsi256_si128(i), _mm256_extracti128_si256(i, 1));
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packus_epi16(p16, p16));
+	}
+
+	friend VecF operator+(VecF a, VecF b) { return {_mm256_add_ps(a.v, b.v)}; }
+	friend VecF operator-(VecF a, VecF b) { return {_mm256_sub_ps(a.v, b.v)}; }
+	friend VecF operator*(VecF a, VecF b) { return {_mm256_mul_ps(a.v, b.v)}; }
+	friend VecF operator/(VecF a, VecF b) { return {_mm256_div_ps(a.v, b.v)}; }
+	friend VecF min(VecF a, VecF b) { return {_mm256_min_ps(a.v, b.v)}; }
+	friend VecF max(VecF a, VecF b) { return {_mm256_max_ps(a.v, b.v)}; }
+#ifdef __FMA__
+	friend VecF fmadd(VecF a, VecF b, VecF c) { return {_mm256_fmadd_ps(a.v, b.v, c.v)}; }
+#else
+	friend VecF fmadd(VecF a, VecF b, VecF c) { return {_mm256_add_ps(_mm256_mul_ps(a.v, b.v), c.v)}; }
+#endif
+
+	// Nearest integer, and 2^n for an integral n within the range of normal floats
+	friend VecF round(VecF a) { return {_mm256_cvtepi32_ps(_mm256_cvtps_epi32(a.v))}; }
+	static VecF pow2(VecF n) { return {_mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n.v), _mm256_set1_epi32(127)), 23))}; }
+};
+
+#define CVPP_SIMD_INT 1
+
+struct VecI
+{
+	static constexpr size_t Width = 16;
+	__m256i v;
+
+	static VecI set1(int32_t i) { return {_mm256_set1_epi32(i)}; }
+	static VecI pair(int16_t a, int16_t b) { return {_mm256_set1_epi32(int32_t(uint16_t(a)) | (int32_t(b) << 16))}; }
+	static VecI loadU8(const uint8_t* p) { return {_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)))}; }
+
+	static void storeU8(uint8_t* p, VecI lo, VecI hi, unsigned int shift)
+	{
+		const __m128i s = _mm_cvtsi32_si128(shift);
+		const __m256i w = _mm256_packs_epi32(_mm256_sra_epi32(lo.v, s), _mm256_sra_epi32(hi.v, s));
+		const __m256i b = _mm256_permute4x64_epi64(_mm256_packus_epi16(w, w), 0x08);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm256_castsi256_si128(b));
+	}
+
+	friend VecI unpackLo(VecI a, VecI b) { return {_mm256_unpacklo_epi16(a.v, b.v)}; }
+	friend VecI unpackHi(VecI a, VecI b) { return {_mm256_unpackhi_epi16(a.v, b.v)}; }
+	friend VecI madd(VecI a, VecI b) { return {_mm256_madd_epi16(a.v, b.v)}; }
+	friend VecI operator+(VecI a, VecI b) { return {_mm256_add_epi32(a.v, b.v)}; }
+};
+
+#define CVPP_SIMD_GATHER 1
+
+struct VecG
+{
+	static constexpr size_t Width = 8;
+	__m256i v;
+
+	static VecG set1(int32_t i) { return {_mm256_set1_epi32(i)}; }
+	static VecG load(const int32_t* p) { return {_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))}; }
+	static VecG loadU16(const uint16_t* p) { return {_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)))}; }
+
+	template<int Scale>
+	static VecG gather(const void* base, VecG offsets) { return {_mm256_i32gather_epi32(static_cast<const int*>(base), offsets.v, Scale)}; }
+
+	void storeU8(uint8_t* p) const
+	{
+		const __m128i p16 = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packus_epi16(p16, p16));
+	}
+
+	friend VecG operator+(VecG a, VecG b) { return {_mm256_add_epi32(a.v, b.v)}; }
+	friend VecG operator&(VecG a, VecG b) { return {_mm256_and_si256(a.v, b.v)}; }
+	friend VecG operator<<(VecG a, unsigned int n) { return {_mm256_sll_epi32(a.v, _mm_cvtsi32_si128(n))}; }
+	friend VecG operator>>(VecG a, unsigned int n) { return {_mm256_srl_epi32(a.v, _mm_cvtsi32_si128(n))}; }
+	friend VecG madd(VecG a, VecG b) { return {_mm256_madd_epi16(a.v, b.v)}; }
+};
+
+#elif defined(__SSE2__)
+
+struct VecF
+{
+	static constexpr size_t Width = 4;
+	__m128 v;
+
+	static VecF zero() { return {_mm_setzero_ps()}; }
+	static VecF set1(float f) { return {_mm_set1_ps(f)}; }
+	static VecF load(const float* p) { return {_mm_loadu_ps(p)}; }
+	void store(float* p) const { _mm_storeu_ps(p, v); }
+
+	static VecF loadU8(const uint8_t* p)
+	{
+		int32_t bytes;
+		std::memcpy(&bytes, p, sizeof(bytes));
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i i16 = _mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero);
+		return {_mm_cvtepi32_ps(_mm_unpacklo_epi16(i16, zero))};
+	}
+
+	void storeU8(uint8_t* p) const
+	{
+		const __m128i i = _mm_cvttps_epi32(v);
+		const __m128i p16 = _mm_packs_epi32(i, i);
+		const int32_t bytes = _mm_cvtsi128_si32(_mm_packus_epi16(p16, p16));
+		std::memcpy(p, &bytes, sizeof(bytes));
+	}
+
+	friend VecF operator+(VecF a, VecF b) { return {_mm_add_ps(a.v, b.v)}; }
+	friend VecF operator-(VecF a, VecF b) { return {_mm_sub_ps(a.v, b.v)}; }
+	friend VecF operator*(VecF a, VecF b) { return {_mm_mul_ps(a.v, b.v)}; }
+	friend VecF operator/(VecF a, VecF b) { return {_mm_div_ps(a.v, b.v)}; }
+	friend VecF min(VecF a, VecF b) { return {_mm_min_ps(a.v, b.v)}; }
+	friend VecF max(VecF a, VecF b) { return {_mm_max_ps(a.v, b.v)}; }
+	friend VecF fmadd(VecF a, VecF b, VecF c) { return {_mm_add_ps(_mm_mul_ps(a.v, b.v), c.v)}; }
+
+	// Nearest integer, and 2^n for an integral n within the range of normal floats
+	friend VecF round(VecF a) { return {_mm_cvtepi32_ps(_mm_cvtps_epi32(a.v))}; }
+	static VecF pow2(VecF n) { return {_mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(n.v), _mm_set1_epi32(127)), 23))}; }
+};
+
+
+#define CVPP_SIMD_INT 1
+
+struct VecI
+{
+	static constexpr size_t Width = 8;
+	__m128i v;
+
+	static VecI set1(int32_t i) { return {_mm_set1_epi32(i)}; }
+	static VecI pair(int16_t a, int16_t b) { return {_mm_set1_epi32(int32_t(uint16_t(a)) | (int32_t(b) << 16))}; }
+	static VecI loadU8(const uint8_t* p)
+	{
+		return {_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), _mm_setzero_si128())};
+	}
+
+	static void storeU8(uint8_t* p, VecI lo, VecI hi, unsigned int shift)
+	{
+		const __m128i s = _mm_cvtsi32_si128(shift);
+		const __m128i w = _mm_packs_epi32(_mm_sra_epi32(lo.v, s), _mm_sra_epi32(hi.v, s));
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packus_epi16(w, w));
+	}
+
+	friend VecI unpackLo(VecI a, VecI b) { return {_mm_unpacklo_epi16(a.v, b.v)}; }
+	friend VecI unpackHi(VecI a, VecI b) { return {_mm_unpackhi_epi16(a.v, b.v)}; }
+	friend VecI madd(VecI a, VecI b) { return {_mm_madd_epi16(a.v, b.v)}; }
+	friend VecI operator+(VecI a, VecI b) { return {_mm_add_epi32(a.v, b.v)}; }
+};
+
+#else
+
+struct VecF
+{
+	static constexpr size_t Width = 1;
+	float v;
+
+	static VecF zero() { return {0.0f}; }
+	static VecF set1(float f) { return {f}; }
+	static VecF load(const float* p) { return {*p}; }
+	void store(float* p) const { *p = v; }
+
+	static VecF loadU8(const uint8_t* p) { return {float(*p)}; }
+	void storeU8(uint8_t* p) const { *p = uint8_t(v); }
+
+	friend VecF operator+(VecF a, VecF b) { return {a.v + b.v}; }
+	friend VecF operator-(VecF a, VecF b) { return {a.v - b.v}; }
+	friend VecF operator*(VecF a, VecF b) { return {a.v * b.v}; }
+	friend VecF operator/(VecF a, VecF b) { return {a.v / b.v}; }
+	friend VecF min(VecF a, VecF b) { return {a.v < b.v ? a.v : b.v}; }
+	friend VecF max(VecF a, VecF b) { return {a.v > b.v ? a.v : b.v}; }
+	friend VecF fmadd(VecF a, VecF b, VecF c) { return {a.v * b.v + c.v}; }
+	friend VecF round(VecF a) { return {std::nearbyint(a.v)}; }
+	static VecF pow2(VecF n) { return {std::ldexp(1.0f, int(n.v))}; }
+};
+
+#endif
+
+}
+
+#endif
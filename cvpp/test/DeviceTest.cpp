@@ -5,8 +5,10 @@
 #include <cvpp/CommonFilters.h>
 #include <cvpp/StructureTensor.h>
 #include <cvpp/HarrisDetector.h>
+#include <cvpp/KernelDecomposition.h>
 
 #include <Eigen/Dense>
+#include <map>
 
 #define TESTIMG "../test1.png"
 
@@ -44,6 +46,21 @@ TEST(Sampler, ClampSampler)
 	EXPECT_LT((c2-c4).norm(), 0.0001f);
 }
 
+TEST(Sampler, IntegerSamples)
+{
+	// Integer samples go through normalized coordinates and have to land on their own texel
+	for(int w = 2; w <= 256; w++)
+	{
+		cvpp::CPUImage<float> img(w, 3, 1);
+		for(int x = 0; x < w; x++)
+			*img.get(x, 1) = float(x);
+
+		cvpp::SamplerView sampler(img);
+		for(int x = 0; x < w; x++)
+			ASSERT_EQ(sampler.sample(x, 1)[0], float(x)) << w;
+	}
+}
+
 TEST(Utils, Mod)
 {
 	EXPECT_EQ(cvpp::mod(-5, 2), cvpp::mod(5, 2));
@@ -122,6 +139,31 @@ TEST(Convolution, GaussFilter)
 	auto out = cvpp::ConvoluteSeparable(sampler, cvpp::GaussFilter<11>(2.0f));
 
 	out.save("ConvolutionGaussFilter.png");
+
+	// Taps are centered on the middle one at whole pixel spacing
+	const auto kernel = cvpp::GaussFilter<9>(1.5f);
+	float sum = 0.0f;
+	for(int i = 0; i < 9; i++)
+	{
+		const float x = i - 4;
+		EXPECT_FLOAT_EQ(kernel[i], kernel[8 - i]);
+		EXPECT_NEAR(kernel[i]/kernel[4], std::exp(-x*x/(2.0f*1.5f*1.5f)), 1e-6f);
+		sum += kernel[i];
+	}
+
+	EXPECT_NEAR(sum, 1.0f, 1e-6f);
+
+	// An impulse stays in place and spreads symmetrically
+	cvpp::CPUImage<float> impulse(15, 15, 1);
+	*impulse.get(7, 7) = 1.0f;
+	auto blurred = cvpp::ConvoluteSeparable(cvpp::ClampView(impulse), kernel);
+	for(int y = 0; y < 15; y++)
+		for(int x = 0; x < 15; x++)
+		{
+			EXPECT_NEAR(*blurred.get(x, y), *blurred.get(14 - x, y), 1e-7f);
+			EXPECT_NEAR(*blurred.get(x, y), *blurred.get(x, 14 - y), 1e-7f);
+			EXPECT_LE(*blurred.get(x, y), *blurred.get(7, 7));
+		}
 }
 
 TEST(Convolution, StackBlur)
@@ -195,6 +237,70 @@ TEST(Structure, StructureTensor)
 	(img * cvpp::MakeRGB(cvpp::ConvertType<float, unsigned char>(determinant))).save("StructureStructureTensor.png");
 }
 
+TEST(Structure, FusedStructureTensor)
+{
+	cvpp::CPUImage<uint8_t> img(TESTIMG);
+	const auto tensor = cvpp::StructureTensor(img);
+	ASSERT_EQ(tensor.getWidth(), img.getWidth());
+	ASSERT_EQ(tensor.getHeight(), img.getHeight());
+
+	// The separate passes the tensor used to be built from
+	auto gray = cvpp::MakeGrayscale(cvpp::ConvertType<uint8_t, float>(img));
+	auto [Dx, Dy] = cvpp::ConvoluteMulti(cvpp::ClampView(gray), cvpp::ScharrKernelH(), cvpp::ScharrKernelV());
+	auto Sx = cvpp::ConvoluteSeparable(cvpp::ClampView(Dx*Dx), cvpp::GaussFilter<3>(1.0f));
+	auto Sy = cvpp::ConvoluteSeparable(cvpp::ClampView(Dy*Dy), cvpp::GaussFilter<3>(1.0f));
+	auto Sxy = cvpp::ConvoluteSeparable(cvpp::ClampView(Dx*Dy), cvpp::GaussFilter<3>(1.0f));
+
+	const auto matrices = tensor.toMatrices();
+	for(size_t i = 0; i < Sx.getData().size(); i++)
+	{
+		const Eigen::Matrix2f& mtx = matrices[i];
+		ASSERT_NEAR(mtx(0, 0), Sx[i], 1e-4f*(1.0f + Sx[i]));
+		ASSERT_NEAR(mtx(1, 1), Sy[i], 1e-4f*(1.0f + Sy[i]));
+		ASSERT_NEAR(mtx(0, 1), Sxy[i], 1e-4f*(1.0f + std::abs(Sxy[i])));
+		ASSERT_EQ(mtx(0, 1), mtx(1, 0));
+	}
+}
+
+TEST(Structure, HessianResponse)
+{
+	// Exact second derivatives on a quadratic, away from the borders
+	cvpp::CPUImage<float> quadratic(64, 64, 1);
+	for(int y = 0; y < 64; y++)
+		for(int x = 0; x < 64; x++)
+			*quadratic.get(x, y) = 0.001f*(x - 32)*(x - 32) + 0.002f*(x - 32)*(y - 32) + 0.003f*(y - 32)*(y - 32);
+
+	const auto hessian = cvpp::HessianTensor(quadratic, 2.0f).get(32, 32);
+	EXPECT_NEAR(hessian(0, 0), 0.002f, 1e-5f);
+	EXPECT_NEAR(hessian(0, 1), 0.002f, 1e-5f);
+	EXPECT_NEAR(hessian(1, 1), 0.006f, 1e-5f);
+
+	const auto determinant = cvpp::HessianResponse(quadratic, 2.0f);
+	EXPECT_NEAR(*determinant.get(32, 32), 16.0f*(0.002f*0.006f - 0.002f*0.002f), 1e-6f);
+
+	// A Gaussian blob of sigma 4 answers most strongly at sigma 4 on both responses
+	cvpp::CPUImage<float> blob(64, 64, 1);
+	for(int y = 0; y < 64; y++)
+		for(int x = 0; x < 64; x++)
+			*blob.get(x, y) = std::exp(-float((x - 32)*(x - 32) + (y - 32)*(y - 32))/(2.0f*16.0f));
+
+	const std::vector<float> sigmas = {2.0f, 3.0f, 4.0f, 5.0f, 6.0f};
+	const auto determinants = cvpp::HessianResponse(blob, sigmas, cvpp::HESSIAN_DETERMINANT);
+	const auto traces = cvpp::HessianResponse(blob, sigmas, cvpp::HESSIAN_TRACE);
+
+	int bestDeterminant = 0, bestTrace = 0;
+	for(int i = 0; i < sigmas.size(); i++)
+	{
+		if(*determinants[i].get(32, 32) > *determinants[bestDeterminant].get(32, 32))
+			bestDeterminant = i;
+		if(-*traces[i].get(32, 32) > -*traces[bestTrace].get(32, 32))
+			bestTrace = i;
+	}
+
+	EXPECT_EQ(sigmas[bestDeterminant], 4.0f);
+	EXPECT_EQ(sigmas[bestTrace], 4.0f);
+}
+
 TEST(Detector, Harris)
 {
 	cvpp::CPUImage<uint8_t> img(TESTIMG);
@@ -208,6 +314,48 @@ TEST(Detector, Harris)
 
 	for(int i = 0; i < 10 && i < features.size(); i++)
 		std::cout << features[i].x << ", " << features[i].y << " -> " << features[i].scale << std::endl;
+
+	cvpp::CPUImage<uint8_t> square(200, 100, 1);
+	std::fill(square.getData().begin(), square.getData().end(), 0);
+	for(int y = 40; y < 60; y++)
+		for(int x = 90; x < 110; x++)
+			*square.get(x, y) = 255;
+
+	// Without a threshold the flat background is one plateau of zero responses, which
+	// leaves its first pixel next to the four corners
+	features.clear();
+	cvpp::HarrisDetector(square, 11, 0.0f, features);
+	ASSERT_EQ(features.size(), 5);
+	EXPECT_EQ(features[0].x, 0);
+	EXPECT_EQ(features[0].y, 0);
+}
+
+TEST(Detector, HarrisLaplace)
+{
+	// The corners of a square take a scale which grows with the square
+	std::vector<float> scales;
+	for(int size : {6, 12, 24})
+	{
+		cvpp::CPUImage<uint8_t> img(128, 128, 1);
+		std::fill(img.getData().begin(), img.getData().end(), 0);
+		for(int y = 64 - size/2; y < 64 + size/2; y++)
+			for(int x = 64 - size/2; x < 64 + size/2; x++)
+				*img.get(x, y) = 255;
+
+		std::vector<cvpp::Feature> features;
+		cvpp::HarrisDetector(img, 128, 0.0f, features);
+		// All four corners answer alike and share a window, ties keep the top left one
+		ASSERT_EQ(features.size(), 1);
+		EXPECT_LE(std::abs(int(features[0].x) - (64 - size/2)), 1);
+		EXPECT_LE(std::abs(int(features[0].y) - (64 - size/2)), 1);
+
+		std::cout << size << " -> " << features[0].scale << std::endl;
+		scales.push_back(features[0].scale);
+	}
+
+	EXPECT_GT(scales[0], 1.0f);
+	EXPECT_NEAR(scales[1], 2.0f*scales[0], 0.5f*scales[0]);
+	EXPECT_NEAR(scales[2], 2.0f*scales[1], 0.5f*scales[1]);
 }
 
 TEST(Detector, Hessian)
@@ -241,6 +389,1173 @@ TEST(Convolution, Laplace)
 	Dxy.save("ConvolutionLaplaceXY.png");
 }
 
+#include <cvpp/Remap.h>
+
+TEST(Remap, Identity)
+{
+	cvpp::CPUImage<uint8_t> img(TESTIMG);
+
+	cvpp::RemapTable table(img.getWidth(), img.getHeight(), [](int x, int y) {
+		return Eigen::Vector2f(x, y);
+	});
+
+	auto out = cvpp::Remap(cvpp::ClampView(img), table);
+	EXPECT_EQ(out.getData(), img.getData());
+}
+
+TEST(Remap, Undistort)
+{
+	cvpp::CPUImage<uint8_t> img(TESTIMG);
+
+	Eigen::Matrix3f K;
+	K <<	img.getWidth(), 0, img.getWidth()*0.5f,
+			0, img.getWidth(), img.getHeight()*0.5f,
+			0, 0, 1;
+
+	Eigen::Matrix<float, 5, 1> dist;
+	dist << -0.3f, 0.1f, 0.0f, 0.0f, 0.0f;
+
+	auto table = cvpp::RemapTable::Undistortion(img.getWidth(), img.getHeight(), K, dist);
+	auto out = cvpp::Remap(cvpp::ClampView(img), table);
+
+	// The optical center does not move.
+	const unsigned int cx = img.getWidth()/2, cy = img.getHeight()/2;
+	for(int c = 0; c < img.getComponents(); c++)
+		EXPECT_EQ(out.get(cx, cy)[c], img.get(cx, cy)[c]);
+
+	out.save("RemapUndistort.png");
+}
+
+TEST(Remap, FixedPoint)
+{
+	const cvpp::CPUImage<uint8_t> rgb(TESTIMG);
+	const auto gray = cvpp::MakeGrayscale(rgb);
+
+	// A rotation about the center hits every fraction and leaves the image at the corners
+	for(const auto* img : {&rgb, &gray})
+	{
+		const int w = img->getWidth(), h = img->getHeight(), comps = img->getComponents();
+		const cvpp::RemapTable table(w, h, [&](int x, int y) {
+			const float c = std::cos(0.3f), s = std::sin(0.3f);
+			const float dx = x - 0.5f*w, dy = y - 0.5f*h;
+			return Eigen::Vector2f(0.5f*w + c*dx - s*dy, 0.5f*h + s*dx + c*dy);
+		});
+
+		const auto out = cvpp::Remap(cvpp::ClampView(*img), table);
+		const auto& weights = cvpp::RemapTable::getWeights();
+		for(int y = 0; y < h; y++)
+			for(int x = 0; x < w; x++)
+			{
+				const int sx = table.getCoords(x, y)[0], sy = table.getCoords(x, y)[1];
+				if(sx < 0 || sy < 0 || sx + 1 >= w || sy + 1 >= h)
+					continue;
+
+				const auto& wt = weights[*table.getFractions(x, y)];
+				for(int c = 0; c < comps; c++)
+				{
+					const int sum = wt.fixed[0]*img->get(sx, sy)[c] + wt.fixed[1]*img->get(sx + 1, sy)[c]
+									+ wt.fixed[2]*img->get(sx, sy + 1)[c] + wt.fixed[3]*img->get(sx + 1, sy + 1)[c];
+					ASSERT_EQ(out.get(x, y)[c], (sum + (1 << (cvpp::RemapTable::WeightBits - 1))) >> cvpp::RemapTable::WeightBits)
+						<< x << " " << y << " " << c;
+				}
+			}
+	}
+}
+
+#include <cvpp/Dispatch.h>
+
+TEST(Dispatch, Levels)
+{
+	cvpp::CPUImage<uint8_t> img(TESTIMG);
+	const auto& data = img.getData();
+	const size_t count = data.size();
+
+	const float kernel[] = {0.25f, -0.5f, 1.0f, -0.5f, 0.25f};
+	const auto* generic = cvpp::Dispatch::getKernels(cvpp::Dispatch::GENERIC);
+	ASSERT_NE(generic, nullptr);
+
+	std::vector<float> ref(count), refConv(count - 12);
+	generic->u8ToFloat(data.data(), ref.data(), count);
+	generic->convolveRow(ref.data(), refConv.data(), refConv.size(), kernel, 5, 3);
+
+	std::cout << "Selected ISA: " << cvpp::Dispatch::getISAName(cvpp::Dispatch::getISA()) << std::endl;
+	for(int i = cvpp::Dispatch::GENERIC; i < cvpp::Dispatch::ISA_COUNT; i++)
+	{
+		const auto* table = cvpp::Dispatch::getKernels(cvpp::Dispatch::ISA_LEVEL(i));
+		if(!table)
+			continue;
+
+		std::vector<float> f(count), conv(refConv.size());
+		std::vector<uint8_t> back(count);
+
+		table->u8ToFloat(data.data(), f.data(), count);
+		table->floatToU8(f.data(), back.data(), count);
+		table->convolveRow(f.data(), conv.data(), conv.size(), kernel, 5, 3);
+
+		float min, max;
+		table->minMax(f.data(), count, min, max);
+
+		EXPECT_EQ(f, ref) << cvpp::Dispatch::getISAName(table->level);
+		EXPECT_NEAR(table->sum(f.data(), count), generic->sum(ref.data(), count), 1e-2);
+		EXPECT_EQ(min, *std::min_element(ref.begin(), ref.end()));
+		EXPECT_EQ(max, *std::max_element(ref.begin(), ref.end()));
+
+		for(size_t j = 0; j < conv.size(); j++)
+			ASSERT_NEAR(conv[j], refConv[j], 1e-5f) << cvpp::Dispatch::getISAName(table->level);
+
+		// Bilinear taps scattered over the image, neighbours 1 and 3 bytes apart
+		const auto& pairs = cvpp::RemapTable::getWeightPairs();
+		const size_t stride = size_t(img.getWidth())*img.getComponents();
+		std::vector<int32_t> offsets(1000);
+		std::vector<uint16_t> fractions(offsets.size());
+		for(size_t j = 0; j < offsets.size(); j++)
+		{
+			offsets[j] = int32_t((j*7919) % (count - 2*stride));
+			fractions[j] = uint16_t((j*31) % (pairs.size()/2));
+		}
+
+		for(unsigned int step : {1, 3, 4})
+		{
+			std::vector<uint8_t> bilinear(offsets.size()), refBilinear(offsets.size());
+			table->bilinearU8(data.data(), offsets.data(), fractions.data(), pairs.data(), bilinear.data(), offsets.size(),
+							  step, stride, cvpp::RemapTable::WeightBits);
+			generic->bilinearU8(data.data(), offsets.data(), fractions.data(), pairs.data(), refBilinear.data(), offsets.size(),
+								step, stride, cvpp::RemapTable::WeightBits);
+			EXPECT_EQ(bilinear, refBilinear) << cvpp::Dispatch::getISAName(table->level) << " " << step;
+		}
+	}
+}
+
+TEST(Dispatch, ParseISAName)
+{
+	using namespace cvpp::Dispatch;
+
+	for(int i = GENERIC; i < ISA_COUNT; i++)
+	{
+		ISA_LEVEL level = GENERIC;
+		EXPECT_TRUE(parseISAName(getISAName(ISA_LEVEL(i)), level));
+		EXPECT_EQ(level, ISA_LEVEL(i));
+	}
+
+	ISA_LEVEL level = GENERIC;
+	EXPECT_TRUE(parseISAName("sse42", level));
+	EXPECT_EQ(level, SSE42);
+	EXPECT_TRUE(parseISAName("SSE4_2", level));
+	EXPECT_EQ(level, SSE42);
+	EXPECT_TRUE(parseISAName("AVX-512", level));
+	EXPECT_EQ(level, AVX512);
+
+	EXPECT_FALSE(parseISAName("", level));
+	EXPECT_FALSE(parseISAName("avx", level));
+	EXPECT_FALSE(parseISAName("avx5120", level));
+	EXPECT_FALSE(parseISAName("neon", level));
+}
+
+TEST(Convolution, Conv1DReference)
+{
+	cvpp::CPUImage<uint8_t> img(TESTIMG);
+	auto gray = cvpp::ConvertType<uint8_t, float>(img);
+	cvpp::ClampView sampler(gray);
+
+	Eigen::VectorXf krnl(5);
+	krnl << 0.1f, -0.7f, 0.2f, 0.9f, -0.5f;
+
+	auto h = cvpp::Convolute1D<cvpp::HORIZONTAL>(sampler, krnl);
+	auto v = cvpp::Convolute1D<cvpp::VERTICAL>(sampler, krnl);
+
+	const int w = gray.getWidth(), ht = gray.getHeight(), comps = gray.getComponents();
+	for(int y = 0; y < ht; y++)
+		for(int x = 0; x < w; x++)
+			for(int c = 0; c < comps; c++)
+			{
+				float sh = 0.0f, sv = 0.0f;
+				for(int k = -2; k <= 2; k++)
+				{
+					sh += krnl[k + 2] * gray.get(std::clamp(x + k, 0, w - 1), y)[c];
+					sv += krnl[k + 2] * gray.get(x, std::clamp(y + k, 0, ht - 1))[c];
+				}
+
+				ASSERT_NEAR(h.get(x, y)[c], sh, 1e-5f);
+				ASSERT_NEAR(v.get(x, y)[c], sv, 1e-5f) << x << " " << y;
+			}
+}
+
+template<typename T>
+void CheckConv2D(const cvpp::CPUImage<T>& img, float tolerance)
+{
+	cvpp::ClampView sampler(img);
+
+	Eigen::Matrix<float, 5, 5> krnl;
+	for(int i = 0; i < 25; i++)
+		krnl(i / 5, i % 5) = ((i * 7) % 11 - 5) / 30.0f;
+
+	auto out = cvpp::Convolute2D(sampler, krnl);
+
+	const int w = img.getWidth(), h = img.getHeight(), comps = img.getComponents();
+	for(int y = 0; y < h; y++)
+		for(int x = 0; x < w; x++)
+			for(int c = 0; c < comps; c++)
+			{
+				float sum = 0.0f;
+				for(int ky = -2; ky <= 2; ky++)
+					for(int kx = -2; kx <= 2; kx++)
+						sum += krnl(ky + 2, kx + 2) * cvpp::ColorToFloat(img.get(std::clamp(x + kx, 0, w - 1), std::clamp(y + ky, 0, h - 1))[c]);
+
+				if constexpr(std::is_integral_v<T>)
+					sum = std::clamp(sum, 0.0f, 1.0f);
+
+				ASSERT_NEAR(cvpp::ColorToFloat(out.get(x, y)[c]), sum, tolerance) << x << ", " << y << " with " << comps << " components";
+			}
+}
+
+TEST(Convolution, Conv2DReference)
+{
+	cvpp::CPUImage<uint8_t> img(TESTIMG);
+
+	for(auto& u8 : {cvpp::MakeGrayscale(img), img, cvpp::MakeRGBA(img)})
+	{
+		CheckConv2D(u8, 1.001f/255.0f);
+		CheckConv2D(cvpp::ConvertType<uint8_t, float>(u8), 1e-5f);
+	}
+}
+
+TEST(Convolution, FixedKernel)
+{
+	using Plan = cvpp::detail::FixedKernelPlan<cvpp::ScharrKernelH>;
+	static_assert(Plan::Value.count == 6 && Plan::Value.taps[1] == 2 && Plan::Value.coefficients[3] == -10.0f);
+	static_assert(cvpp::detail::FixedKernelPlan<cvpp::LaplaceKernelXY>::Value.count == 3);
+
+	cvpp::CPUImage<uint8_t> img(TESTIMG);
+	auto rgb = cvpp::ConvertType<uint8_t, float>(img);
+	cvpp::ClampView sampler(rgb);
+
+	auto check = [](const cvpp::CPUImage<float>& a, const cvpp::CPUImage<float>& b) {
+		ASSERT_EQ(a.getData().size(), b.getData().size());
+		for(size_t i = 0; i < a.getData().size(); i++)
+			ASSERT_NEAR(a[i], b[i], 1e-4f) << i;
+	};
+
+	check(cvpp::Convolute2D(sampler, cvpp::ScharrKernelH()), cvpp::Convolute2D(sampler, cvpp::ScharrFilterH()));
+	check(cvpp::Convolute2D(sampler, cvpp::ScharrKernelV()), cvpp::Convolute2D(sampler, cvpp::ScharrFilterV()));
+	check(cvpp::Convolute2D(sampler, cvpp::SobelKernelV()), cvpp::Convolute2D(sampler, cvpp::SobelFilterV()));
+	check(cvpp::Convolute2D(sampler, cvpp::LaplaceKernel()), cvpp::Convolute2D(sampler, cvpp::LaplaceFilter()));
+}
+
+TEST(Convolution, SeparableDecomposition)
+{
+	cvpp::CPUImage<uint8_t> img(TESTIMG);
+	auto rgb = cvpp::ConvertType<uint8_t, float>(img);
+	cvpp::ClampView sampler(rgb);
+
+	Eigen::VectorXf a(7), b(7), c(7), d(7);
+	a << 1, 2, 3, 4, 3, 2, 1;
+	b << -1, -2, -1, 0, 1, 2, 1;
+	c << 0, 1, 0, -2, 0, 1, 0;
+	d << 1, 1, 1, 1, 1, 1, 1;
+
+	Eigen::MatrixXf rank1 = a*b.transpose()/100.0f;
+	Eigen::MatrixXf rank2 = rank1 + c*d.transpose()/20.0f;
+	Eigen::MatrixXf full = Eigen::MatrixXf::Identity(7, 7) + rank2;
+
+	EXPECT_EQ(cvpp::DecomposeKernel(rank1).getRank(), 1);
+	EXPECT_EQ(cvpp::DecomposeKernel(rank2).getRank(), 2);
+	EXPECT_FALSE(cvpp::DecomposeKernel(full).isSeparable());
+	EXPECT_EQ(cvpp::DecomposeKernel(cvpp::SobelFilterH()).getRank(), 1);
+
+	for(const Eigen::MatrixXf& k : {rank1, rank2})
+	{
+		auto separable = cvpp::Convolute2D(sampler, k);
+		auto direct = cvpp::Convolute2D(sampler, k, k.rows());
+
+		for(size_t i = 0; i < direct.getData().size(); i++)
+			ASSERT_NEAR(separable[i], direct[i], 1e-4f) << i;
+	}
+}
+
+TEST(Convolution, SeparableFused)
+{
+	cvpp::CPUImage<uint8_t> img(TESTIMG);
+	auto rgb = cvpp::ConvertType<uint8_t, float>(img);
+	cvpp::ClampView sampler(rgb);
+
+	Eigen::VectorXf smooth(5), derive(5);
+	smooth << 1, 4, 6, 4, 1;
+	smooth /= 16.0f;
+	derive << -1, -2, 0, 2, 1;
+
+	auto horizontal = cvpp::Convolute1D<cvpp::HORIZONTAL>(sampler, derive);
+	auto reference = cvpp::Convolute1D<cvpp::VERTICAL>(cvpp::ClampView(horizontal), smooth);
+	auto fused = cvpp::ConvoluteSeparable(sampler, derive, smooth);
+
+	for(size_t i = 0; i < reference.getData().size(); i++)
+		ASSERT_NEAR(fused[i], reference[i], 1e-5f) << i;
+
+	// The intermediate rows are no longer quantized, so 8 bit results may differ by one step
+	cvpp::ClampView sampler8(img);
+	auto blur = cvpp::ConvoluteSeparable(sampler8, smooth);
+	auto blurRef = cvpp::Convolute1D<cvpp::VERTICAL>(cvpp::ClampView(cvpp::Convolute1D<cvpp::HORIZONTAL>(sampler8, smooth)), smooth);
+	for(size_t i = 0; i < blurRef.getData().size(); i++)
+		ASSERT_LE(std::abs(int(blur[i]) - int(blurRef[i])), 1) << i;
+}
+
+TEST(Convolution, FFT)
+{
+	cvpp::CPUImage<uint8_t> img(TESTIMG);
+	auto rgb = cvpp::ConvertType<uint8_t, float>(img);
+	auto gray = cvpp::MakeGrayscale(rgb);
+
+	// Full rank, so neither the separable path nor symmetry hides a flipped kernel
+	Eigen::MatrixXf kernel(17, 17);
+	for(int r = 0; r < kernel.rows(); r++)
+		for(int c = 0; c < kernel.cols(); c++)
+			kernel(r, c) = float((r*7 + c*13) % 11) - 5.0f + (r == c ? 3.0f : 0.0f);
+	kernel /= kernel.cwiseAbs().sum();
+
+	ASSERT_FALSE(cvpp::DecomposeKernel(kernel).isSeparable());
+
+	for(const auto* image : {&rgb, &gray})
+	{
+		cvpp::ClampView sampler(*image);
+		auto fft = cvpp::ConvoluteFFT(sampler, kernel);
+		auto direct = cvpp::Convolute2D(sampler, kernel, kernel.rows());
+
+		for(size_t i = 0; i < direct.getData().size(); i++)
+			ASSERT_NEAR(fft[i], direct[i], 1e-4f) << i;
+	}
+}
+
+#include <cvpp/Blur.h>
+
+TEST(Blur, RunningSums)
+{
+	cvpp::CPUImage<uint8_t> img(TESTIMG);
+	auto rgb = cvpp::ConvertType<uint8_t, float>(img);
+	cvpp::ClampView sampler(rgb);
+
+	auto box = cvpp::BoxBlur(sampler, 7);
+	auto boxRef = cvpp::ConvoluteSeparable(sampler, cvpp::BoxFilter<15>());
+	for(size_t i = 0; i < boxRef.getData().size(); i++)
+		ASSERT_NEAR(box[i], boxRef[i], 1e-4f) << i;
+
+	auto stack = cvpp::StackBlur(sampler, 7);
+	auto stackRef = cvpp::ConvoluteSeparable(sampler, cvpp::StackBlurFilter<15>());
+	for(size_t i = 0; i < stackRef.getData().size(); i++)
+		ASSERT_NEAR(stack[i], stackRef[i], 1e-4f) << i;
+
+	// Narrow and tall, so the rows are split into several bands with seams inside the windows
+	cvpp::CPUImage<float> tall(40, 1000, 1);
+	for(int y = 0; y < tall.getHeight(); y++)
+		for(int x = 0; x < tall.getWidth(); x++)
+			*tall.get(x, y) = float((x*7 + y*13) % 29)/28.0f;
+
+	cvpp::ClampView tallSampler(tall);
+	auto tallBox = cvpp::BoxBlur(tallSampler, 20);
+	auto tallRef = cvpp::ConvoluteSeparable(tallSampler, cvpp::BoxFilter<41>());
+	for(size_t i = 0; i < tallRef.getData().size(); i++)
+		ASSERT_NEAR(tallBox[i], tallRef[i], 1e-4f) << i;
+
+	// Radius far beyond the image height only sees clamped border rows
+	cvpp::StackBlur(cvpp::ClampView(img), 300).save("BlurStackBlur.png");
+}
+
+TEST(Blur, RecursiveGaussian)
+{
+	cvpp::CPUImage<uint8_t> img(TESTIMG);
+	auto rgb = cvpp::ConvertType<uint8_t, float>(img);
+	cvpp::ClampView sampler(rgb);
+
+	for(float sigma : {1.0f, 3.0f, 8.0f})
+	{
+		const int half = std::ceil(4.0f*sigma);
+		Eigen::VectorXf gauss(2*half + 1);
+		for(int i = -half; i <= half; i++)
+			gauss[i + half] = std::exp(-0.5f*i*i/(sigma*sigma));
+		gauss /= gauss.sum();
+
+		auto recursive = cvpp::RecursiveGaussian(sampler, sigma);
+		auto reference = cvpp::ConvoluteSeparable(sampler, gauss);
+
+		float maxError = 0.0f;
+		for(size_t i = 0; i < reference.getData().size(); i++)
+			maxError = std::max(maxError, std::abs(recursive[i] - reference[i]));
+
+		EXPECT_LT(maxError, 0.01f) << "sigma " << sigma;
+	}
+}
+
+#include <cvpp/IntegralImage.h>
+
+TEST(IntegralImage, RectSum)
+{
+	cvpp::CPUImage<uint8_t> img(TESTIMG);
+	cvpp::IntegralImage sums(img);
+	cvpp::IntegralImage<uint8_t, true> squares(img);
+
+	// 320x240x255 fits into 32 bits, the squares do not
+	EXPECT_FALSE(sums.isWide());
+	EXPECT_TRUE(squares.isWide());
+
+	const unsigned int rects[][4] = {{0, 0, img.getWidth(), img.getHeight()}, {13, 7, 14, 8}, {100, 50, 219, 201}, {5, 5, 5, 9}};
+	for(const auto& r : rects)
+	{
+		for(unsigned int c = 0; c < img.getComponents(); c++)
+		{
+			uint64_t sum = 0, sq = 0;
+			for(unsigned int y = r[1]; y < r[3]; y++)
+				for(unsigned int x = r[0]; x < r[2]; x++)
+				{
+					const uint64_t v = img.get(x, y)[c];
+					sum += v;
+					sq += v*v;
+				}
+
+			EXPECT_EQ(sums.rectSum(r[0], r[1], r[2], r[3], c), double(sum));
+			EXPECT_EQ(squares.rectSum(r[0], r[1], r[2], r[3], c), double(sq));
+		}
+	}
+}
+
+TEST(IntegralImage, LocalStatistics)
+{
+	cvpp::CPUImage<uint8_t> img(TESTIMG);
+	constexpr int Radius = 4;
+
+	auto stats = cvpp::LocalStatistics(img, Radius);
+	auto box = cvpp::BoxBlur(cvpp::ClampView(cvpp::ConvertType<uint8_t, float>(img)), Radius);
+
+	for(int y = Radius; y < img.getHeight() - Radius; y += 7)
+	{
+		for(int x = Radius; x < img.getWidth() - Radius; x += 5)
+		{
+			for(int c = 0; c < img.getComponents(); c++)
+			{
+				float sq = 0.0f;
+				for(int ky = -Radius; ky <= Radius; ky++)
+					for(int kx = -Radius; kx <= Radius; kx++)
+						sq += std::pow(cvpp::ColorToFloat(img.get(x + kx, y + ky)[c]), 2.0f);
+
+				const float mean = box.get(x, y)[c];
+				const float variance = sq/((2*Radius + 1)*(2*Radius + 1)) - mean*mean;
+
+				ASSERT_NEAR(stats.mean.get(x, y)[c], mean, 1e-5f);
+				ASSERT_NEAR(stats.variance.get(x, y)[c], variance, 1e-5f);
+			}
+		}
+	}
+}
+
+TEST(Convolution, FixedPoint)
+{
+	cvpp::CPUImage<uint8_t> img(TESTIMG);
+	auto rgb = cvpp::ConvertType<uint8_t, float>(img);
+
+	Eigen::MatrixXf smooth(5, 5);
+	for(int r = 0; r < 5; r++)
+		for(int c = 0; c < 5; c++)
+			smooth(r, c) = float(1 + (r*5 + c) % 7);
+	smooth /= smooth.sum();
+
+	Eigen::VectorXf line(7);
+	line << 0.05f, 0.1f, 0.2f, 0.3f, 0.2f, 0.1f, 0.05f;
+
+	auto check = [](const cvpp::CPUImage<uint8_t>& fixed, const cvpp::CPUImage<float>& exact, const std::vector<float>& kernel) {
+		const auto quantized = cvpp::detail::QuantizeKernel(kernel);
+		ASSERT_LT(quantized.maxError, cvpp::detail::MaxFixedPointError);
+
+		for(size_t i = 0; i < exact.getData().size(); i++)
+		{
+			const float value = std::clamp(exact[i], 0.0f, 1.0f)*255.0f;
+			ASSERT_LE(std::abs(fixed[i] - value), quantized.maxError + 0.5f + 1e-3f) << i;
+
+			// The float path truncates, so the rounded result is the same or one step above
+			const int diff = int(fixed[i]) - int(cvpp::FloatToColor<uint8_t>(exact[i]));
+			ASSERT_TRUE(diff == 0 || diff == 1) << i;
+		}
+	};
+
+	const auto coeffs2D = cvpp::detail::KernelCoefficients2D(smooth, 5);
+	check(cvpp::Convolute2D(cvpp::ClampView(img), smooth, 5), cvpp::Convolute2D(cvpp::ClampView(rgb), smooth, 5), coeffs2D);
+
+	const auto coeffs1D = cvpp::detail::KernelCoefficients(line, 7);
+	check(cvpp::Convolute1D<cvpp::HORIZONTAL>(cvpp::ClampView(img), line), cvpp::Convolute1D<cvpp::HORIZONTAL>(cvpp::ClampView(rgb), line), coeffs1D);
+	check(cvpp::Convolute1D<cvpp::VERTICAL>(cvpp::ClampView(img), line), cvpp::Convolute1D<cvpp::VERTICAL>(cvpp::ClampView(rgb), line), coeffs1D);
+
+	// Negative taps saturate at zero
+	const auto sobel = cvpp::detail::KernelCoefficients2D(cvpp::SobelFilterH()/8.0f, 3);
+	check(cvpp::Convolute2D(cvpp::ClampView(img), cvpp::SobelFilterH()/8.0f, 3), cvpp::Convolute2D(cvpp::ClampView(rgb), cvpp::SobelFilterH()/8.0f, 3), sobel);
+
+	// All instruction sets agree, including the scalar tail
+	const auto quantized = cvpp::detail::QuantizeKernel(coeffs2D);
+	const size_t count = 3*101 + 7;
+	std::vector<uint8_t> data(count + 4*3*5);
+	for(size_t i = 0; i < data.size(); i++)
+		data[i] = (i*2654435761u) >> 24;
+
+	const uint8_t* rows[5];
+	for(int r = 0; r < 5; r++)
+		rows[r] = &data[r*11];
+
+	std::vector<uint8_t> expected(count), result(count);
+	cvpp::Dispatch::getKernels(cvpp::Dispatch::GENERIC)->convolveU8(rows, expected.data(), count, quantized.coefficients.data(), 5, 5, 3, quantized.shift);
+	for(int level = cvpp::Dispatch::GENERIC; level < cvpp::Dispatch::ISA_COUNT; level++)
+	{
+		if(const auto* table = cvpp::Dispatch::getKernels(cvpp::Dispatch::ISA_LEVEL(level)))
+		{
+			table->convolveU8(rows, result.data(), count, quantized.coefficients.data(), 5, 5, 3, quantized.shift);
+			EXPECT_EQ(result, expected) << cvpp::Dispatch::getISAName(cvpp::Dispatch::ISA_LEVEL(level));
+		}
+	}
+}
+
+TEST(Convolution, Multi)
+{
+	cvpp::CPUImage<uint8_t> img(TESTIMG);
+	auto rgb = cvpp::ConvertType<uint8_t, float>(img);
+	cvpp::ClampView sampler(rgb);
+
+	auto check = [](const cvpp::CPUImage<float>& a, const cvpp::CPUImage<float>& b) {
+		ASSERT_EQ(a.getData().size(), b.getData().size());
+		for(size_t i = 0; i < a.getData().size(); i++)
+			ASSERT_NEAR(a[i], b[i], 1e-5f) << i;
+	};
+
+	// Kernels of different sizes share the window of the largest one
+	auto [dx, dy, laplace, box] = cvpp::ConvoluteMulti(sampler, cvpp::ScharrKernelH(), cvpp::ScharrKernelV(),
+													   cvpp::LaplaceKernelX(), cvpp::FixedKernel<5, 1, 1, 1, 1, 1,
+																								 1, 1, 1, 1, 1,
+																								 1, 1, 1, 1, 1,
+																								 1, 1, 1, 1, 1,
+																								 1, 1, 1, 1, 1>());
+	check(dx, cvpp::Convolute2D(sampler, cvpp::ScharrKernelH()));
+	check(dy, cvpp::Convolute2D(sampler, cvpp::ScharrKernelV()));
+	check(laplace, cvpp::Convolute1D<cvpp::HORIZONTAL>(sampler, cvpp::LaplaceFilterX));
+	check(box, cvpp::Convolute2D(sampler, Eigen::MatrixXf::Ones(5, 5).eval(), 5));
+
+	const std::vector<Eigen::MatrixXf> kernels = {cvpp::SobelFilterH(), cvpp::LaplaceFilter(), cvpp::LaplaceFilterXY()};
+	auto planes = cvpp::ConvoluteMulti(sampler, kernels);
+	ASSERT_EQ(planes.size(), kernels.size());
+	for(size_t k = 0; k < kernels.size(); k++)
+		check(planes[k], cvpp::Convolute2D(sampler, kernels[k], 3));
+}
+
+TEST(Convolution, Decimated)
+{
+	cvpp::CPUImage<uint8_t> img(TESTIMG);
+	auto rgb = cvpp::ConvertType<uint8_t, float>(img);
+	cvpp::ClampView sampler(rgb);
+
+	Eigen::MatrixXf full(5, 5);
+	for(int r = 0; r < 5; r++)
+		for(int c = 0; c < 5; c++)
+			full(r, c) = float(1 + (r*5 + c) % 7)/100.0f;
+
+	auto check = [&](const cvpp::CPUImage<float>& decimated, const cvpp::CPUImage<float>& reference, unsigned int factor) {
+		ASSERT_EQ(decimated.getWidth(), (rgb.getWidth() + factor - 1)/factor);
+		ASSERT_EQ(decimated.getHeight(), (rgb.getHeight() + factor - 1)/factor);
+		for(unsigned int y = 0; y < decimated.getHeight(); y++)
+			for(unsigned int x = 0; x < decimated.getWidth(); x++)
+				for(unsigned int c = 0; c < 3; c++)
+					ASSERT_NEAR(decimated.get(x, y)[c], reference.get(x*factor, y*factor)[c], 1e-5f) << x << " " << y;
+	};
+
+	for(unsigned int factor : {1, 2, 3, 6})
+	{
+		check(cvpp::ConvoluteSeparableDecimated(sampler, cvpp::GaussFilter<5>(1.0f), factor), cvpp::ConvoluteSeparable(sampler, cvpp::GaussFilter<5>(1.0f)), factor);
+		check(cvpp::Convolute2DDecimated(sampler, full, factor), cvpp::Convolute2D(sampler, full, 5), factor);
+	}
+}
+
+TEST(Convolution, PatchReduce)
+{
+	cvpp::CPUImage<uint8_t> img(TESTIMG);
+	auto rgb = cvpp::ConvertType<uint8_t, float>(img);
+	cvpp::ClampView sampler(rgb);
+
+	auto argmax = [](int x, int y, auto v, auto& result) {
+		if(v[1] >= result[0])
+		{
+			result[0] = v[1];
+			result[1] = x;
+			result[2] = y;
+		}
+	};
+
+	// Same patches and results as the strided NonLinearConv2D
+	const unsigned int size = 9;
+	const unsigned int tilesX = (rgb.getWidth() + size - 1)/size;
+	std::vector<Eigen::Vector4f> reference(tilesX*((rgb.getHeight() + size - 1)/size));
+	cvpp::NonLinearConv2D<-1>(sampler, size, argmax, [&](uint32_t x, uint32_t y, const Eigen::Vector4f& v) {
+		reference[(y/size)*tilesX + x/size] = v;
+	});
+
+	const auto reduced = cvpp::PatchReduce(sampler, size, argmax);
+	ASSERT_EQ(reduced.size(), reference.size());
+	for(size_t i = 0; i < reduced.size(); i++)
+		EXPECT_EQ(reduced[i], reference[i]) << i;
+}
+
+TEST(Convolution, PatchReduceEvenSize)
+{
+	cvpp::CPUImage<uint8_t> img(TESTIMG);
+	auto rgb = cvpp::ConvertType<uint8_t, float>(img);
+	cvpp::ClampView sampler(rgb);
+	const int w = rgb.getWidth();
+	const int h = rgb.getHeight();
+
+	// Patches of even sizes span 2*(size/2) + 1 rows and columns, one more than size
+	for(int size : {4, 8})
+	{
+		const int halfSize = size/2;
+		const int tilesX = (w + size - 1)/size;
+		const auto reduced = cvpp::PatchReduce(sampler, size, [](int, int, auto v, auto& acc) { acc += v; });
+		ASSERT_EQ(reduced.size(), size_t(tilesX)*((h + size - 1)/size));
+
+		for(int y = 0; y < h; y += size)
+		{
+			for(int x = 0; x < w; x += size)
+			{
+				Eigen::Vector4f sum(0, 0, 0, 0);
+				for(int ky = -halfSize; ky <= halfSize; ky++)
+					for(int kx = -halfSize; kx <= halfSize; kx++)
+						for(int c = 0; c < 3; c++)
+							sum[c] += rgb.get(std::clamp(x + kx, 0, w - 1), std::clamp(y + ky, 0, h - 1))[c];
+
+				const Eigen::Vector4f& patch = reduced[(y/size)*tilesX + x/size];
+				for(int c = 0; c < 4; c++)
+					ASSERT_NEAR(patch[c], sum[c], 1e-6f*std::abs(sum[c]) + 1e-3f) << size << " " << x << " " << y;
+			}
+		}
+	}
+}
+
+#include <cvpp/MedianFilter.h>
+
+template<typename T>
+void CheckMedian(const cvpp::CPUImage<T>& img, unsigned int radius)
+{
+	cvpp::ClampView sampler(img);
+	auto median = cvpp::MedianFilter(sampler, radius);
+
+	const int r = radius;
+	const int w = img.getWidth();
+	const int h = img.getHeight();
+	const int comps = img.getComponents();
+	std::vector<T> window;
+	for(int y = 0; y < h; y++)
+	{
+		for(int x = 0; x < w; x++)
+		{
+			for(int c = 0; c < comps; c++)
+			{
+				window.clear();
+				for(int ky = -r; ky <= r; ky++)
+					for(int kx = -r; kx <= r; kx++)
+						window.push_back(img.get(std::clamp(x + kx, 0, w - 1), std::clamp(y + ky, 0, h - 1))[c]);
+
+				std::nth_element(window.begin(), window.begin() + window.size()/2, window.end());
+				ASSERT_EQ(median.get(x, y)[c], window[window.size()/2]) << radius << ": " << x << " " << y << " " << c;
+			}
+		}
+	}
+}
+
+TEST(Filter, Median)
+{
+	cvpp::CPUImage<uint8_t> img(TESTIMG);
+	static_assert(cvpp::detail::MedianNetwork<9>::Value.count < 30);
+
+	// Thermal like data in a narrow range of 16 bit values
+	cvpp::CPUImage<uint16_t> wide(97, 61, 1);
+	for(size_t i = 0; i < wide.getData().size(); i++)
+		wide[i] = 30000 + ((i*2654435761u) >> 20) % 700;
+
+	for(unsigned int radius : {1, 2, 3, 6})
+	{
+		CheckMedian(img, radius);
+		CheckMedian(cvpp::MakeGrayscale(img), radius);
+		CheckMedian(wide, radius);
+	}
+
+	// Windows of more than 65535 values need wider histogram counts. The outliers stay
+	// off the border, which is repeated by the clamping, so one value fills most of them.
+	cvpp::CPUImage<uint8_t> small(23, 17, 1);
+	cvpp::CPUImage<uint16_t> smallWide(23, 17, 1);
+	for(int y = 0; y < small.getHeight(); y++)
+	{
+		for(int x = 0; x < small.getWidth(); x++)
+		{
+			const bool outlier = x > 0 && y > 0 && x < 22 && y < 16 && (x + 2*y) % 5 == 0;
+			*small.get(x, y) = (outlier ? 250 : 10);
+			*smallWide.get(x, y) = (outlier ? 60000 : 30000);
+		}
+	}
+
+	CheckMedian(small, 130);
+	CheckMedian(smallWide, 130);
+}
+
+#include <cvpp/Morphology.h>
+
+TEST(Filter, Morphology)
+{
+	cvpp::CPUImage<uint8_t> img(TESTIMG);
+	cvpp::ClampView sampler(img);
+	const int w = img.getWidth();
+	const int h = img.getHeight();
+
+	auto reference = [&](const cvpp::CPUImage<uint8_t>& src, int width, int height, bool dilate) {
+		cvpp::CPUImage<uint8_t> out(w, h, 3);
+		for(int y = 0; y < h; y++)
+			for(int x = 0; x < w; x++)
+				for(int c = 0; c < 3; c++)
+				{
+					uint8_t v = dilate ? 0 : 255;
+					for(int ky = -height/2; ky <= height/2; ky++)
+						for(int kx = -width/2; kx <= width/2; kx++)
+						{
+							const uint8_t s = src.get(std::clamp(x + kx, 0, w - 1), std::clamp(y + ky, 0, h - 1))[c];
+							v = dilate ? std::max(v, s) : std::min(v, s);
+						}
+					out.get(x, y)[c] = v;
+				}
+		return out;
+	};
+
+	for(auto [width, height] : {std::pair{1, 1}, std::pair{3, 5}, std::pair{15, 7}, std::pair{31, 1}})
+	{
+		const auto eroded = reference(img, width, height, false);
+		const auto dilated = reference(img, width, height, true);
+		EXPECT_EQ(cvpp::Erode(sampler, width, height).getData(), eroded.getData()) << width << "x" << height;
+		EXPECT_EQ(cvpp::Dilate(sampler, width, height).getData(), dilated.getData()) << width << "x" << height;
+
+		const auto opened = reference(eroded, width, height, true);
+		EXPECT_EQ(cvpp::Open(sampler, width, height).getData(), opened.getData());
+		EXPECT_EQ(cvpp::Close(sampler, width, height).getData(), reference(dilated, width, height, false).getData());
+
+		const auto topHat = cvpp::TopHat(sampler, width, height);
+		const auto gradient = cvpp::MorphologicalGradient(sampler, width, height);
+		for(size_t i = 0; i < img.getData().size(); i++)
+		{
+			ASSERT_EQ(topHat[i], img[i] - opened[i]);
+			ASSERT_EQ(gradient[i], dilated[i] - eroded[i]);
+		}
+	}
+}
+
+#include <cvpp/BilateralFilter.h>
+
+TEST(Filter, Bilateral)
+{
+	cvpp::CPUImage<uint8_t> img(TESTIMG);
+	auto gray = cvpp::ConvertType<uint8_t, float>(cvpp::MakeGrayscale(img));
+	const int w = gray.getWidth();
+	const int h = gray.getHeight();
+	const float sigmaSpace = 4.0f, sigmaRange = 0.1f;
+
+	// Brute force bilateral filter over 3 sigma
+	const int r = 3*sigmaSpace;
+	cvpp::CPUImage<float> reference(w, h, 1);
+	for(int y = 0; y < h; y++)
+		for(int x = 0; x < w; x++)
+		{
+			const float center = *gray.get(x, y);
+			float sum = 0.0f, norm = 0.0f;
+			for(int ky = std::max(0, y - r); ky <= std::min(h - 1, y + r); ky++)
+				for(int kx = std::max(0, x - r); kx <= std::min(w - 1, x + r); kx++)
+				{
+					const float v = *gray.get(kx, ky);
+					const float d2 = float((kx - x)*(kx - x) + (ky - y)*(ky - y))/(sigmaSpace*sigmaSpace);
+					const float r2 = (v - center)*(v - center)/(sigmaRange*sigmaRange);
+					const float weight = std::exp(-0.5f*(d2 + r2));
+					sum += weight*v;
+					norm += weight;
+				}
+			*reference.get(x, y) = sum/norm;
+		}
+
+	auto filtered = cvpp::BilateralFilter(cvpp::ClampView(gray), sigmaSpace, sigmaRange);
+	double error = 0.0;
+	for(size_t i = 0; i < gray.getData().size(); i++)
+		error += std::abs(filtered[i] - reference[i]);
+
+	error /= gray.getData().size();
+	std::cout << "Mean error: " << error << std::endl;
+	EXPECT_LT(error, 0.01);
+
+	// Flat regions stay flat and both sides of a step keep their level
+	cvpp::CPUImage<uint8_t> step(64, 32, 3);
+	for(int y = 0; y < 32; y++)
+		for(int x = 0; x < 64; x++)
+			for(int c = 0; c < 3; c++)
+				step.get(x, y)[c] = (x < 32 ? 40 : 200);
+
+	auto smoothed = cvpp::BilateralFilter(cvpp::ClampView(step), 8.0f, 0.1f);
+	for(size_t i = 0; i < step.getData().size(); i++)
+		ASSERT_NEAR(smoothed[i], step[i], 1) << i;
+}
+
+#include <cvpp/GuidedFilter.h>
+
+TEST(Filter, Guided)
+{
+	cvpp::CPUImage<uint8_t> img(TESTIMG);
+	auto gray = cvpp::ConvertType<uint8_t, float>(cvpp::MakeGrayscale(img));
+	auto color = cvpp::ConvertType<uint8_t, float>(img);
+	const int w = gray.getWidth();
+	const int h = gray.getHeight();
+	const int r = 4;
+	const float eps = 0.01f;
+
+	// Brute force box means over clamped windows
+	auto boxMean = [&](const std::vector<double>& v, int x, int y) {
+		double sum = 0.0;
+		for(int ky = y - r; ky <= y + r; ky++)
+			for(int kx = x - r; kx <= x + r; kx++)
+				sum += v[std::clamp(ky, 0, h - 1)*w + std::clamp(kx, 0, w - 1)];
+		return sum/((2*r + 1)*(2*r + 1));
+	};
+
+	// One guide channel for all input channels and one per input channel
+	for(const cvpp::CPUImage<float>* guide : {&gray, &color})
+	{
+		const int guideComps = guide->getComponents();
+		auto filtered = cvpp::GuidedFilter(*guide, color, r, eps);
+		ASSERT_EQ(filtered.getComponents(), color.getComponents());
+
+		double maxError = 0.0;
+		for(int c = 0; c < color.getComponents(); c++)
+		{
+			std::vector<double> I(w*h), p(w*h), Ip(w*h), II(w*h), a(w*h), b(w*h);
+			for(int i = 0; i < w*h; i++)
+			{
+				I[i] = (*guide)[i*guideComps + (guideComps == 1 ? 0 : c)];
+				p[i] = color[i*color.getComponents() + c];
+				Ip[i] = I[i]*p[i];
+				II[i] = I[i]*I[i];
+			}
+
+			for(int y = 0; y < h; y++)
+				for(int x = 0; x < w; x++)
+				{
+					const double meanI = boxMean(I, x, y), meanP = boxMean(p, x, y);
+					a[y*w + x] = (boxMean(Ip, x, y) - meanI*meanP)/(boxMean(II, x, y) - meanI*meanI + eps);
+					b[y*w + x] = meanP - a[y*w + x]*meanI;
+				}
+
+			for(int y = 0; y < h; y++)
+				for(int x = 0; x < w; x++)
+				{
+					const double q = boxMean(a, x, y)*I[y*w + x] + boxMean(b, x, y);
+					maxError = std::max(maxError, std::abs(q - filtered.get(x, y)[c]));
+				}
+		}
+
+		std::cout << "Max error: " << maxError << std::endl;
+		EXPECT_LT(maxError, 1e-5);
+	}
+
+	// The guide's edge survives in a noisy input
+	cvpp::CPUImage<float> step(64, 32, 1), noisy(64, 32, 1);
+	for(int y = 0; y < 32; y++)
+		for(int x = 0; x < 64; x++)
+		{
+			*step.get(x, y) = (x < 32 ? 0.2f : 0.8f);
+			*noisy.get(x, y) = *step.get(x, y) + ((x*7 + y*13) % 5 - 2)*0.01f;
+		}
+
+	auto smoothed = cvpp::GuidedFilter(step, noisy, 6, 1e-4f);
+	for(size_t i = 0; i < step.getData().size(); i++)
+		ASSERT_NEAR(smoothed[i], step[i], 0.01f) << i;
+}
+
+#include <cvpp/NonLocalMeans.h>
+
+template<typename T>
+static void CheckNonLocalMeans(const cvpp::CPUImage<T>& img, float h, int searchRadius, int patchRadius, float tolerance)
+{
+	const int w = img.getWidth();
+	const int height = img.getHeight();
+	const int comps = img.getComponents();
+	auto at = [&](int x, int y, int c) { return cvpp::ColorToFloat<T>(img.get(std::clamp(x, 0, w - 1), std::clamp(y, 0, height - 1))[c]); };
+
+	auto filtered = cvpp::NonLocalMeans(cvpp::ClampView(img), h, searchRadius, patchRadius);
+	const int n = (2*patchRadius + 1)*(2*patchRadius + 1)*comps;
+
+	for(int y = 0; y < height; y++)
+		for(int x = 0; x < w; x++)
+		{
+			double sum[4] = {}, norm = 0.0;
+			for(int dy = -searchRadius; dy <= searchRadius; dy++)
+				for(int dx = -searchRadius; dx <= searchRadius; dx++)
+				{
+					double d2 = 0.0;
+					for(int py = -patchRadius; py <= patchRadius; py++)
+						for(int px = -patchRadius; px <= patchRadius; px++)
+							for(int c = 0; c < comps; c++)
+							{
+								const double d = at(x + px, y + py, c) - at(x + dx + px, y + dy + py, c);
+								d2 += d*d;
+							}
+
+					const double weight = std::exp(-d2/(n*h*h));
+					norm += weight;
+					for(int c = 0; c < comps; c++)
+						sum[c] += weight*at(x + dx, y + dy, c);
+				}
+
+			for(int c = 0; c < comps; c++)
+				ASSERT_NEAR(cvpp::ColorToFloat<T>(filtered.get(x, y)[c]), sum[c]/norm, tolerance) << x << " " << y;
+		}
+}
+
+TEST(Filter, NonLocalMeans)
+{
+	// Exponential of the kernel tables against the standard library
+	std::vector<float> values;
+	for(float v = -90.0f; v < 5.0f; v += 0.0173f)
+		values.push_back(v);
+
+	for(int level = cvpp::Dispatch::GENERIC; level < cvpp::Dispatch::ISA_COUNT; level++)
+	{
+		const auto* table = cvpp::Dispatch::getKernels(cvpp::Dispatch::ISA_LEVEL(level));
+		if(!table)
+			continue;
+
+		std::vector<float> result(values.size());
+		table->exp(values.data(), result.data(), values.size());
+		for(size_t i = 0; i < values.size(); i++)
+			ASSERT_NEAR(result[i], std::exp(values[i]), 1e-6f*std::exp(values[i]) + 1e-37f) << values[i];
+	}
+
+	cvpp::CPUImage<uint8_t> img(TESTIMG);
+	CheckNonLocalMeans(img, 0.05f, 3, 1, 1.0f/255.0f + 1e-4f);
+
+	auto gray = cvpp::ConvertType<uint8_t, float>(cvpp::MakeGrayscale(img));
+	CheckNonLocalMeans(gray, 0.1f, 4, 2, 1e-4f);
+
+	// Noise on a flat image goes down
+	cvpp::CPUImage<float> noisy(96, 80, 1);
+	for(size_t i = 0; i < noisy.getData().size(); i++)
+		noisy[i] = 0.5f + (uint32_t(i*2654435761u) >> 24)/255.0f*0.1f - 0.05f;
+
+	auto denoised = cvpp::NonLocalMeans(cvpp::ClampView(noisy), 0.1f);
+	double before = 0.0, after = 0.0;
+	for(size_t i = 0; i < noisy.getData().size(); i++)
+	{
+		before += std::abs(noisy[i] - 0.5f);
+		after += std::abs(denoised[i] - 0.5f);
+	}
+
+	EXPECT_LT(after, 0.25*before);
+}
+
+#include <cvpp/Pyramid.h>
+
+TEST(Pyramid, GaussianAndLaplacian)
+{
+	const auto binomial = cvpp::BinomialFilter<5>();
+	const float expected[] = {1.0f/16, 4.0f/16, 6.0f/16, 4.0f/16, 1.0f/16};
+	for(int i = 0; i < 5; i++)
+		EXPECT_FLOAT_EQ(binomial[i], expected[i]);
+
+	cvpp::CPUImage<uint8_t> img(TESTIMG);
+	cvpp::ImagePyramid<uint8_t> pyramid(img, 5);
+	ASSERT_EQ(pyramid.getLevelCount(), 5);
+
+	// Levels are built on demand from the one before
+	const auto& level2 = pyramid.getLevel(2);
+	const auto level1 = cvpp::ConvoluteSeparableDecimated(cvpp::ClampView(img), binomial, 2);
+	EXPECT_EQ(pyramid.getLevel(1).getData(), level1.getData());
+	EXPECT_EQ(level2.getData(), cvpp::ConvoluteSeparableDecimated(cvpp::ClampView(level1), binomial, 2).getData());
+
+	pyramid.build();
+	unsigned int w = img.getWidth(), h = img.getHeight();
+	for(unsigned int level = 0; level < pyramid.getLevelCount(); level++)
+	{
+		EXPECT_EQ(pyramid.getLevel(level).getWidth(), w);
+		EXPECT_EQ(pyramid.getLevel(level).getHeight(), h);
+		w = (w + 1)/2;
+		h = (h + 1)/2;
+	}
+
+	// Collapsing the Laplacian levels gives the image back
+	auto gray = cvpp::ConvertType<uint8_t, float>(cvpp::MakeGrayscale(img));
+	cvpp::ImagePyramid<float> laplacian(gray, 4);
+	cvpp::CPUImage<float> collapsed = laplacian.getLaplacian(3);
+	for(int level = 2; level >= 0; level--)
+	{
+		const auto& band = laplacian.getLaplacian(level);
+		collapsed = band + cvpp::detail::PyramidExpand(cvpp::ClampView(collapsed), band.getWidth(), band.getHeight());
+	}
+
+	for(size_t i = 0; i < gray.getData().size(); i++)
+		ASSERT_NEAR(collapsed[i], gray[i], 1e-5f) << i;
+
+	// Levels asked for from several threads at once are built once and match
+	cvpp::ImagePyramid<float> shared(gray, 4);
+	std::vector<const cvpp::CPUImage<float>*> bands(8);
+#pragma omp parallel for
+	for(int i = 0; i < 8; i++)
+		bands[i] = &shared.getLaplacian(3 - i % 4);
+
+	shared.build(true);
+	for(int i = 0; i < 8; i++)
+	{
+		EXPECT_EQ(bands[i], &shared.getLaplacian(3 - i % 4));
+		EXPECT_EQ(bands[i]->getData(), laplacian.getLaplacian(3 - i % 4).getData());
+	}
+
+	// A flat image has flat levels and no detail
+	cvpp::CPUImage<float> flat(37, 21, 2);
+	std::fill(flat.getData().begin(), flat.getData().end(), 0.25f);
+	cvpp::ImagePyramid<float> flatPyramid(flat, 3);
+	for(float v : flatPyramid.getLevel(2).getData())
+		ASSERT_NEAR(v, 0.25f, 1e-6f);
+	for(float v : flatPyramid.getLaplacian(0).getData())
+		ASSERT_NEAR(v, 0.0f, 1e-6f);
+}
+
+#include <cvpp/NonMaxSuppression.h>
+
+TEST(Feature, NonMaxSuppression)
+{
+	// Random responses against a brute force search of every window, once more with
+	// only 8 levels so that many maxima tie
+	cvpp::CPUImage<float> random(203, 157, 1), levels(203, 157, 1);
+	for(size_t i = 0; i < random.getData().size(); i++)
+	{
+		random[i] = float(uint32_t(i*2654435761u) >> 8)/float(1 << 24);
+		levels[i] = float(uint32_t(i*2654435761u) >> 29)/8.0f;
+	}
+
+	for(const auto* image : {&random, &levels})
+	{
+		for(unsigned int radius : {1, 2, 5})
+		{
+			const auto& response = *image;
+			std::vector<cvpp::Feature> features;
+			cvpp::NonMaxSuppression(response, radius, 0.25f, features);
+
+			std::vector<cvpp::Feature> expected;
+			for(int y = 0; y < response.getHeight(); y++)
+				for(int x = 0; x < response.getWidth(); x++)
+				{
+					// Clamped samples repeat pixels of the window, so only those inside the image
+					// are compared. Ties lose against pixels before them in row major order.
+					const float v = *response.get(x, y);
+					bool isMax = v >= 0.25f;
+					for(int dy = -int(radius); dy <= int(radius) && isMax; dy++)
+						for(int dx = -int(radius); dx <= int(radius) && isMax; dx++)
+						{
+							const int sx = x + dx;
+							const int sy = y + dy;
+							if(sx < 0 || sy < 0 || sx >= int(response.getWidth()) || sy >= int(response.getHeight()))
+								continue;
+
+							const float s = *response.get(sx, sy);
+							isMax = (dy < 0 || (dy == 0 && dx < 0) ? s < v : s <= v);
+						}
+
+					if(isMax)
+						expected.push_back(cvpp::Feature{unsigned(x), unsigned(y), 0.0f});
+				}
+
+			// Same features in the same row major order
+			ASSERT_FALSE(features.empty());
+			ASSERT_EQ(features.size(), expected.size());
+			for(size_t i = 0; i < features.size(); i++)
+			{
+				EXPECT_EQ(features[i].x, expected[i].x);
+				EXPECT_EQ(features[i].y, expected[i].y);
+			}
+		}
+	}
+
+	// The threshold itself passes, like in the detectors before
+	cvpp::CPUImage<float> peak(9, 9, 1);
+	*peak.get(4, 4) = 0.5f;
+	std::vector<cvpp::Feature> features;
+	cvpp::NonMaxSuppression(peak, 2, 0.5f, features);
+	ASSERT_EQ(features.size(), 1);
+	EXPECT_EQ(features[0].x, 4);
+	EXPECT_EQ(features[0].y, 4);
+
+	// A plateau leaves its first pixel, a flat image only the origin
+	cvpp::CPUImage<float> plateau(64, 48, 1);
+	std::fill(plateau.getData().begin(), plateau.getData().end(), 0.0f);
+	for(int y = 10; y < 30; y++)
+		for(int x = 20; x < 40; x++)
+			*plateau.get(x, y) = 1.0f;
+
+	features.clear();
+	cvpp::NonMaxSuppression(plateau, 5, 0.5f, features);
+	ASSERT_EQ(features.size(), 1);
+	EXPECT_EQ(features[0].x, 20);
+	EXPECT_EQ(features[0].y, 10);
+
+	std::fill(plateau.getData().begin(), plateau.getData().end(), 0.25f);
+	features.clear();
+	cvpp::NonMaxSuppression(plateau, 5, 0.0f, features);
+	ASSERT_EQ(features.size(), 1);
+	EXPECT_EQ(features[0].x, 0);
+	EXPECT_EQ(features[0].y, 0);
+}
+
+TEST(Feature, Selection)
+{
+	std::vector<cvpp::Feature> features;
+	for(uint32_t i = 0; i < 5000; i++)
+	{
+		const uint32_t hash = i*2654435761u;
+		features.push_back(cvpp::Feature{hash % 640, (hash >> 10) % 480, 1.0f, float(hash >> 20)});
+	}
+
+	auto sorted = features;
+	std::sort(sorted.begin(), sorted.end(), cvpp::detail::StrongerFeature);
+
+	const auto strongest = cvpp::SelectStrongest(features, 100);
+	ASSERT_EQ(strongest.size(), 100);
+	for(size_t i = 0; i < strongest.size(); i++)
+	{
+		EXPECT_EQ(strongest[i].x, sorted[i].x);
+		EXPECT_EQ(strongest[i].y, sorted[i].y);
+	}
+
+	EXPECT_EQ(cvpp::SelectStrongest(features, 10000).size(), features.size());
+
+	// Every cell keeps its own strongest features
+	const unsigned int cellSize = 64;
+	const auto spread = cvpp::SelectStrongestPerCell(features, 640, 480, cellSize, 3);
+	EXPECT_EQ(spread.size(), 10*8*3);
+
+	std::map<int, int> perCell;
+	for(const auto& f : spread)
+	{
+		const int cell = (f.y/cellSize)*10 + f.x/cellSize;
+		const int rank = perCell[cell]++;
+
+		int stronger = 0;
+		for(const auto& other : features)
+			if((other.y/cellSize)*10 + other.x/cellSize == cell && cvpp::detail::StrongerFeature(other, f))
+				stronger++;
+
+		EXPECT_EQ(stronger, rank);
+	}
+
+	// Features outside the image are dropped, however strong
+	auto outside = features;
+	outside.push_back(cvpp::Feature{});
+	outside.push_back(cvpp::Feature{640, 10, 1.0f, 1e6f});
+	outside.push_back(cvpp::Feature{10, 480, 1.0f, 1e6f});
+	const auto inside = cvpp::SelectStrongestPerCell(outside, 640, 480, cellSize, 3);
+	ASSERT_EQ(inside.size(), spread.size());
+	for(size_t i = 0; i < inside.size(); i++)
+	{
+		EXPECT_EQ(inside[i].x, spread[i].x);
+		EXPECT_EQ(inside[i].y, spread[i].y);
+	}
+}
+
 #include <cvpp/Device.h>
 
 TEST(Device, CPU)
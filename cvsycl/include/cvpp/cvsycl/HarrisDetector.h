@@ -58,7 +58,7 @@ void HarrisDetector(Image<T>& in, unsigned int patchSize, float threshold, std::
 	std::mutex mtx;
 
 	cvpp::CPUImage<float> cpuImg = determinant;
-	cvpp::NonLinearConv2D<-1>(cvpp::ClampView(cpuImg), patchSize,
+	cvpp::PatchReduce(cvpp::ClampView(cpuImg), patchSize,
 	[](int x, int y, auto v, auto& result) {
 		auto vabs = std::abs(v[0]);
 		if(vabs >= result[0])
@@ -126,7 +126,7 @@ void HarrisDetector(Image<T>& in, unsigned int patchSize, float threshold, std::
 	std::mutex mtx;
 
 	cvpp::CPUImage<float> cpuImg = determinant;
-	cvpp::NonLinearConv2D<-1>(cvpp::ClampView(cpuImg), patchSize,
+	cvpp::PatchReduce(cvpp::ClampView(cpuImg), patchSize,
 	[](int x, int y, auto v, auto& result) {
 		auto vabs = std::abs(v[0]);
 		if(vabs >= result[0])
@@ -157,7 +157,7 @@ void HessianDetector(Image<T>& in, unsigned int patchSize, float threshold, std:
 	
 	std::mutex mtx;
 	cvpp::CPUImage<float> cpuImg = determinant;
-	cvpp::NonLinearConv2D<-1>(cvpp::ClampView(cpuImg), patchSize,
+	cvpp::PatchReduce(cvpp::ClampView(cpuImg), patchSize,
 	[](int x, int y, auto v, auto& result) {
 		auto vabs = std::abs(v[0]);
 		if(vabs >= result[0])